@@ -0,0 +1,204 @@
+/*+ NtpShm.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CNtpShm NTP shared-memory refclock writer.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "NtpShm.h"
+#include "TsipViews.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                       N T P   S H M   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CNtpShm::CNtpShm()
+{
+    m_ptShm     = NULL;
+    m_nLeap     = LEAP_NOWARNING;
+    m_llLeapNs  = 0;
+    m_ulSamples = 0;
+    m_ulSkipped = 0;
+}
+
+CNtpShm::~CNtpShm()
+{
+    Close();
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Open
+
+Description:    Attaches to the SHM segment of a refclock unit, creating it
+                if the time daemon has not done so yet.
+
+Parameters:     nUnit - the unit, as in "refclock SHM <unit>"
+
+Return Value:   false if the segment could not be created or attached (the
+                reason is printed)
+-----------------------------------------------------------------------------*/
+bool CNtpShm::Open (int nUnit)
+{
+    void *pShm;
+    int   nId;
+
+    nId = shmget(NTP_SHM_KEY + nUnit, sizeof(NTP_SHM_TIME),
+                 IPC_CREAT | (nUnit < 2 ? 0600 : 0666));
+    if (nId == -1)
+    {
+        perror("shmget");
+        return false;
+    }
+
+    pShm = shmat(nId, NULL, 0);
+    if (pShm == (void *)-1)
+    {
+        perror("shmat");
+        return false;
+    }
+
+    m_ptShm = (NTP_SHM_TIME *)pShm;
+    m_ptShm->nValid = 0;
+    m_ptShm->nMode  = 1;
+    return true;
+}
+
+void CNtpShm::Close ()
+{
+    if (m_ptShm != NULL)
+    {
+        shmdt(m_ptShm);
+        m_ptShm = NULL;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Write
+
+Description:    Publishes one sample. The segment is marked invalid and the
+                count bumped around the update, so a reader that races with
+                it sees the count change and discards what it read.
+
+Parameters:     llClockNs   - the true UTC time, ns since the epoch
+                llReceiveNs - the local clock at that moment, ns
+                nLeap       - LEAP_xxx
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CNtpShm::Write (long long llClockNs, long long llReceiveNs, int nLeap)
+{
+    NTP_SHM_TIME *ptShm = m_ptShm;
+
+    if (ptShm == NULL)
+    {
+        return;
+    }
+
+    ptShm->nValid = 0;
+    ptShm->nCount = ptShm->nCount + 1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    ptShm->tClockSec     = (time_t)(llClockNs / 1000000000LL);
+    ptShm->unClockNSec   = (unsigned)(llClockNs % 1000000000LL);
+    ptShm->nClockUSec    = (int)(ptShm->unClockNSec / 1000);
+    ptShm->tReceiveSec   = (time_t)(llReceiveNs / 1000000000LL);
+    ptShm->unReceiveNSec = (unsigned)(llReceiveNs % 1000000000LL);
+    ptShm->nReceiveUSec  = (int)(ptShm->unReceiveNSec / 1000);
+    ptShm->nLeap         = nLeap;
+    ptShm->nPrecision    = NTP_SHM_PRECISION;
+    ptShm->nSamples      = NTP_SHM_SAMPLES;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    ptShm->nCount = ptShm->nCount + 1;
+    ptShm->nValid = 1;
+    m_ulSamples++;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Turns each usable 0x8F-AB into a sample. The date and time
+                fields give the second of the PPS edge the report follows;
+                they are in GPS time unless TIMING_UTC is set, in which case
+                the UTC offset is already applied. 0x8F-AC only supplies the
+                leap second warning. Replayed reports are ignored: they say
+                nothing about the clock now.
+
+                The receiver raises the warning well before the leap, but
+                ntpd and chrony insert the second at the end of the month
+                in which they see it. It is therefore published only in
+                June and December (UTC), and dropped when no 0x8F-AC has
+                confirmed it for NTP_SHM_LEAP_SECS.
+
+                The leap second itself, 23:59:60, is not published: the
+                kernel repeats 23:59:59 for it, and timegm() would turn it
+                into the next midnight, a second off.
+-----------------------------------------------------------------------------*/
+void CNtpShm::OnPacket (CTsipParser *pParser,
+                        unsigned char ucPkt[], int nPktLen)
+{
+    CView0x8FAB tTime(ucPkt, nPktLen);
+    CView0x8FAC tStat(ucPkt, nPktLen);
+    struct tm   tUtc;
+    time_t      tSec;
+    int         nLeap;
+
+    if (pParser->IsReplay())
+    {
+        return;
+    }
+    if (tStat.IsValid())
+    {
+        m_nLeap = (tStat.GetMinorAlarms() & ALARM_LEAP_PENDING) ?
+                  LEAP_ADDSECOND : LEAP_NOWARNING;
+        m_llLeapNs = pParser->GetArrivalTime();
+        return;
+    }
+    if (!tTime.IsValid())
+    {
+        return;
+    }
+
+    if ((tTime.GetTimingFlag() & (TIMING_NOT_SET | TIMING_NO_UTC)) ||
+        pParser->GetArrivalTime() == 0 || tTime.GetYear() < 1980 ||
+        tTime.GetSecond() > 59)
+    {
+        m_ulSkipped++;
+        return;
+    }
+
+    memset(&tUtc, 0, sizeof(tUtc));
+    tUtc.tm_year = tTime.GetYear() - 1900;
+    tUtc.tm_mon  = tTime.GetMonth() - 1;
+    tUtc.tm_mday = tTime.GetDay();
+    tUtc.tm_hour = tTime.GetHour();
+    tUtc.tm_min  = tTime.GetMinute();
+    tUtc.tm_sec  = tTime.GetSecond();
+    tSec = timegm(&tUtc);
+    if (!(tTime.GetTimingFlag() & TIMING_UTC))
+    {
+        tSec -= tTime.GetUtcOffset();
+    }
+
+    if (pParser->GetArrivalTime() - m_llLeapNs >
+        NTP_SHM_LEAP_SECS * 1000000000LL)
+    {
+        m_nLeap = LEAP_NOWARNING;
+    }
+    gmtime_r(&tSec, &tUtc);
+    nLeap = (tUtc.tm_mon == 5 || tUtc.tm_mon == 11) ? m_nLeap : LEAP_NOWARNING;
+
+    Write((long long)tSec * 1000000000LL, pParser->GetArrivalTime(), nLeap);
+}
@@ -0,0 +1,114 @@
+/*+ NtpShm.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines CNtpShm, which feeds the time of a TSIP timing
+ *    receiver to ntpd or chrony through the NTP shared-memory refclock
+ *    (SHM driver, segment key 0x4E545030 + unit).
+ *
+ *    Each 0x8F-AB report gives the UTC second of the PPS edge it follows;
+ *    paired with the arrival time of the report's first byte it makes one
+ *    offset sample, written straight into the segment:
+ *
+ *        chrony:  refclock SHM 0 offset <serial delay> delay 0.01
+ *        ntpd:    server 127.127.28.0  fudge 127.127.28.0 time1 <delay>
+ *
+ *    The fixed delay from the PPS edge to the report must be calibrated
+ *    in the daemon; it depends on the receiver and the baud rate.
+ *
+ * Notes:
+ *    Reports whose timing flags say the time is not set or UTC is not
+ *    known yet are not used, nor is the report of a leap second itself
+ *    (23:59:60). The receiver's leap second warning is only
+ *    passed on in June and December, the months at whose end a leap
+ *    second is inserted, and only while 0x8F-AC keeps confirming it.
+ *    Units 0 and 1 are created readable by root only, as ntpd expects;
+ *    higher units are world readable.
+ *
+-*/
+
+#ifndef NTP_SHM_H
+#define NTP_SHM_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include <time.h>
+#include "TsipParser.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define NTP_SHM_KEY       0x4E545030    // "NTP0"
+#define NTP_SHM_PRECISION (-10)         // ~1 ms, serial arrival time
+#define NTP_SHM_SAMPLES   3             // median filter hint for ntpd
+#define NTP_SHM_LEAP_SECS 10            // 0x8F-AC leap warning lifetime
+
+#define LEAP_NOWARNING    0
+#define LEAP_ADDSECOND    1
+
+// 0x8F-AB timing flags
+#define TIMING_UTC        0x01          // date and time fields are UTC
+#define TIMING_NOT_SET    0x04          // time is not yet set
+#define TIMING_NO_UTC     0x08          // UTC offset not yet known
+
+// 0x8F-AC minor alarms
+#define ALARM_LEAP_PENDING 0x0080
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct NTP_SHM_TIME                     // layout fixed by ntpd refclock_shm
+{
+    int          nMode;                 // 1: use count to detect torn reads
+    volatile int nCount;
+    time_t       tClockSec;             // true time of the sample
+    int          nClockUSec;
+    time_t       tReceiveSec;           // local clock at the sample
+    int          nReceiveUSec;
+    int          nLeap;
+    int          nPrecision;
+    int          nSamples;
+    volatile int nValid;
+    unsigned     unClockNSec;
+    unsigned     unReceiveNSec;
+    int          nDummy[8];
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CNtpShm : public CTsipListener
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CNtpShm();
+    virtual ~CNtpShm();
+
+    bool Open  (int nUnit);
+    void Close ();
+    void Write (long long llClockNs, long long llReceiveNs, int nLeap);
+
+    U32  GetSamples () const { return m_ulSamples; }
+    U32  GetSkipped () const { return m_ulSkipped; }
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    NTP_SHM_TIME *m_ptShm;
+    int           m_nLeap;              // from the latest 0x8F-AC
+    long long     m_llLeapNs;           // arrival time of that 0x8F-AC
+    U32           m_ulSamples;          // samples written
+    U32           m_ulSkipped;          // 0x8F-AB not usable
+};
+
+#endif
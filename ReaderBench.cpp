@@ -0,0 +1,313 @@
+/*+ ReaderBench.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    Compares the CSerialReader backends on pseudo-terminal pairs.
+ *
+ *    A child process plays N receivers: every period it writes one framed
+ *    0x8F-AB packet to the master side of each pty. The parent reads the
+ *    slave sides with each backend in turn and reports the system calls
+ *    made per packet and the CPU time used per port.
+ *
+ *    Finally a recorded stream of timing and signal level packets is run
+ *    through CTsipParser, unfiltered and filtered to 0x8F-AB, and through
+ *    a timing-only CTsipParserT to compare the parse cost per byte. All
+ *    three decode every 0x8F-AB with the same decoder, the CTsipParser
+ *    ones from a listener, so they do the same work per report; the
+ *    template is left with the framing, which both kinds share, and saves
+ *    the listener dispatch. The last line gives its cost relative to the
+ *    filtered CTsipParser; the makefile builds without optimisation, so
+ *    build with -O2 to see what the template's inlining is worth.
+ *
+ *    usage: bench.out [ports] [packets/s per port] [seconds]
+ *
+ * Notes:
+ *    Raise the pty limit (/proc/sys/kernel/pty/max) for very high port
+ *    counts.
+ *
+-*/
+
+#include     <stdio.h>
+#include     <stdlib.h>
+#include     <string.h>
+#include     <unistd.h>
+#include     <fcntl.h>
+#include     <termios.h>
+#include     <time.h>
+#include     <sys/time.h>
+#include     <sys/resource.h>
+#include     <sys/wait.h>
+
+#include "TsipParser.h"
+#include "TsipParserT.h"
+#include "SerialReader.h"
+
+// DLE 8F AB <16 data bytes> DLE ETX, no stuffing needed for this payload.
+static unsigned char gucPkt8FAB[] =
+{
+    DLE, 0x8F, 0xAB, 0x00, 0x01, 0x51, 0x80, 0x08, 0x3C, 0x00, 0x12, 0x03,
+    0x1E, 0x0F, 0x0C, 0x11, 0x0A, 0x07, 0xE9, DLE, ETX
+};
+
+// DLE 47 <count> {<prn> <level>}... DLE ETX, signal levels of 4 satellites:
+// a packet a timing-only deployment does not need.
+static unsigned char gucPkt47[] =
+{
+    DLE, 0x47, 0x04, 0x02, 0x42, 0x20, 0x00, 0x00, 0x05, 0x42, 0x30, 0x00,
+    0x00, 0x0C, 0x42, 0x08, 0x00, 0x00, 0x19, 0x42, 0x18, 0x00, 0x00,
+    DLE, ETX
+};
+
+#define PARSE_STREAM_PKTS  4096
+#define PARSE_CHUNK_LEN    64
+#define PARSE_PASSES       200
+
+// Handler for the timing-only parser.
+struct CTimeSink : CReport0x8FAB
+{
+    U32 ulReports = 0;
+
+    void OnReport (const TSIP_8FAB &) { ulReports++; }
+};
+
+// The same for CTsipParser: decodes every 0x8F-AB with the decoder the
+// template uses, so that both parsers do the same work per report.
+class CTimeListener : public CTsipListener
+{
+public:
+    U32 ulReports = 0;
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen)
+    {
+        TSIP_8FAB tData;
+
+        if (nPktLen > 4 && ucPkt[1] == CReport0x8FAB::ID &&
+            ucPkt[2] == CReport0x8FAB::SUB_ID &&
+            CReport0x8FAB::Decode(&ucPkt[2], nPktLen - 4, &tData))
+        {
+            ulReports++;
+        }
+    }
+};
+
+static int OpenPty(int *pnMaster)
+{
+    struct termios opt;
+    int nMaster, nSlave;
+
+    nMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if(nMaster == -1 || grantpt(nMaster) != 0 || unlockpt(nMaster) != 0)
+    {
+        perror("posix_openpt");
+        return -1;
+    }
+
+    nSlave = open(ptsname(nMaster), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(nSlave == -1)
+    {
+        perror("open pty slave");
+        close(nMaster);
+        return -1;
+    }
+
+    tcgetattr(nSlave, &opt);
+    cfmakeraw(&opt);
+    opt.c_cc[VTIME] = 0;
+    opt.c_cc[VMIN] = 1;
+    tcsetattr(nSlave, TCSANOW, &opt);
+
+    *pnMaster = nMaster;
+    return nSlave;
+}
+
+static void RunWriter(int nMasters[], int nPorts, int nRate, int nSecs)
+{
+    struct timespec tNext;
+    long lPeriodNs = 1000000000L / nRate;
+    int i, n, nTotal = nRate * nSecs;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNext);
+    for(n = 0; n < nTotal; n++)
+    {
+        for(i = 0; i < nPorts; i++)
+        {
+            if(write(nMasters[i], gucPkt8FAB, sizeof(gucPkt8FAB)) < 0)
+            {
+                perror("write");
+                _exit(1);
+            }
+        }
+
+        tNext.tv_nsec += lPeriodNs;
+        while(tNext.tv_nsec >= 1000000000L)
+        {
+            tNext.tv_nsec -= 1000000000L;
+            tNext.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tNext, NULL);
+    }
+
+    // Give the reader time to drain before the ptys hang up.
+    sleep(1);
+    _exit(0);
+}
+
+static int RunBackend(int nBackend, int nPorts, int nRate, int nSecs)
+{
+    CSerialReader reader;
+    CTsipParser *pParsers;
+    int *pnMasters, *pnSlaves;
+    struct rusage tStart, tEnd;
+    double dblCpu;
+    U32 ulPkts = 0;
+    pid_t pid;
+    int i;
+
+    if(!reader.Open(nBackend))
+    {
+        return -1;
+    }
+
+    pParsers  = new CTsipParser[nPorts];
+    pnMasters = new int[nPorts];
+    pnSlaves  = new int[nPorts];
+    for(i = 0; i < nPorts; i++)
+    {
+        pnSlaves[i] = OpenPty(&pnMasters[i]);
+        if(pnSlaves[i] == -1)
+        {
+            return -1;
+        }
+        pParsers[i].SetPrint(false);
+        reader.AddPort(pnSlaves[i], &pParsers[i]);
+    }
+
+    pid = fork();
+    if(pid == 0)
+    {
+        RunWriter(pnMasters, nPorts, nRate, nSecs);
+    }
+    for(i = 0; i < nPorts; i++)
+    {
+        close(pnMasters[i]);
+    }
+
+    getrusage(RUSAGE_SELF, &tStart);
+    while(reader.GetNumActive() > 0)
+    {
+        if(reader.Poll(1000) < 0)
+        {
+            break;
+        }
+    }
+    getrusage(RUSAGE_SELF, &tEnd);
+    waitpid(pid, NULL, 0);
+
+    for(i = 0; i < nPorts; i++)
+    {
+        ulPkts += pParsers[i].GetPktCount();
+        close(pnSlaves[i]);
+    }
+
+    dblCpu = (tEnd.ru_utime.tv_sec  - tStart.ru_utime.tv_sec) +
+             (tEnd.ru_stime.tv_sec  - tStart.ru_stime.tv_sec) +
+             (tEnd.ru_utime.tv_usec - tStart.ru_utime.tv_usec) * 1e-6 +
+             (tEnd.ru_stime.tv_usec - tStart.ru_stime.tv_usec) * 1e-6;
+
+    printf("%-9s ports: %3d  pkts: %8u  syscalls: %8u  syscalls/pkt: %6.3f"
+           "  cpu/port: %8.3f ms\n",
+           nBackend == READER_IO_URING ? "io_uring" : "epoll",
+           nPorts, ulPkts, reader.GetStats().ulSyscalls,
+           ulPkts ? (double)reader.GetStats().ulSyscalls / ulPkts : 0.0,
+           dblCpu * 1000.0 / nPorts);
+
+    delete [] pParsers;
+    delete [] pnMasters;
+    delete [] pnSlaves;
+    return 0;
+}
+
+// Feeds the stream to a parser in reader-sized chunks and returns the time
+// taken per byte.
+template <class P>
+static double TimeParser(P &parser, unsigned char ucStream[], int nLen)
+{
+    struct timespec tStart, tEnd;
+    int n, i;
+
+    clock_gettime(CLOCK_MONOTONIC, &tStart);
+    for(n = 0; n < PARSE_PASSES; n++)
+    {
+        for(i = 0; i < nLen; i += PARSE_CHUNK_LEN)
+        {
+            parser.ReceivePkt(&ucStream[i], nLen - i < PARSE_CHUNK_LEN ?
+                                            nLen - i : PARSE_CHUNK_LEN);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &tEnd);
+
+    return ((tEnd.tv_sec - tStart.tv_sec) * 1e9 +
+            (tEnd.tv_nsec - tStart.tv_nsec)) / ((double)nLen * PARSE_PASSES);
+}
+
+static void RunParsers()
+{
+    CTsipParser full, filtered;
+    CTimeListener tFullSink, tFilteredSink;
+    CTsipParserT<CTimeSink> timing;
+    unsigned char *pucStream;
+    double dblNs, dblFilteredNs;
+    int nLen = 0, i;
+
+    pucStream = new unsigned char[PARSE_STREAM_PKTS *
+                                  (sizeof(gucPkt8FAB) + sizeof(gucPkt47))];
+    for(i = 0; i < PARSE_STREAM_PKTS; i++)
+    {
+        memcpy(&pucStream[nLen], gucPkt8FAB, sizeof(gucPkt8FAB));
+        nLen += sizeof(gucPkt8FAB);
+        memcpy(&pucStream[nLen], gucPkt47, sizeof(gucPkt47));
+        nLen += sizeof(gucPkt47);
+    }
+
+    full.SetPrint(false);
+    full.AddListener(&tFullSink);
+    filtered.SetPrint(false);
+    filtered.AddListener(&tFilteredSink);
+    filtered.RejectAll();
+    filtered.Accept(0x8F, 0xAB);
+
+    dblNs = TimeParser(full, pucStream, nLen);
+    printf("CTsipParser           %6.2f ns/byte  pkts: %6u  8F-AB: %u\n",
+           dblNs, full.GetPktCount(), tFullSink.ulReports);
+    dblFilteredNs = TimeParser(filtered, pucStream, nLen);
+    printf("CTsipParser 8F-AB     %6.2f ns/byte  pkts: %6u  8F-AB: %u\n",
+           dblFilteredNs, filtered.GetPktCount(), tFilteredSink.ulReports);
+    dblNs = TimeParser(timing, pucStream, nLen);
+    printf("CTsipParserT 8F-AB    %6.2f ns/byte  pkts: %6u  8F-AB: %u\n",
+           dblNs, timing.GetPktCount(),
+           timing.GetHandler<CTimeSink>().ulReports);
+    printf("CTsipParserT / CTsipParser 8F-AB: %.2f\n", dblNs / dblFilteredNs);
+
+    delete [] pucStream;
+}
+
+int main(int argc, char *argv[])
+{
+    int nPorts = argc > 1 ? atoi(argv[1]) : 32;
+    int nRate  = argc > 2 ? atoi(argv[2]) : 100;
+    int nSecs  = argc > 3 ? atoi(argv[3]) : 5;
+
+    if(nPorts < 1 || nPorts > MAX_READER_PORTS || nRate < 1 || nSecs < 1)
+    {
+        fprintf(stderr, "usage: %s [ports (1-%d)] [packets/s] [seconds]\n",
+                argv[0], MAX_READER_PORTS);
+        return -1;
+    }
+
+    RunBackend(READER_EPOLL, nPorts, nRate, nSecs);
+    RunBackend(READER_IO_URING, nPorts, nRate, nSecs);
+    RunParsers();
+    return 0;
+}
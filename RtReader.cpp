@@ -0,0 +1,256 @@
+/*+ RtReader.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the real-time mode of the reader thread and the
+ *    CLatencyStats measurements.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "RtReader.h"
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+
+static const char* gstrLatName[NUM_LAT] =
+{
+    "wake", "decode", "phase"
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                       H E L P E R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+static long long NowNs (clockid_t nClock)
+{
+    struct timespec tNow;
+
+    clock_gettime(nClock, &tNow);
+    return (long long)tNow.tv_sec * 1000000000LL + tNow.tv_nsec;
+}
+
+// Touches RT_STACK_PREFAULT bytes of stack so that deeper calls later on
+// do not fault. Not inlined, or the array would live in the caller.
+static void __attribute__((noinline)) PrefaultStack ()
+{
+    volatile unsigned char ucStack[RT_STACK_PREFAULT];
+
+    memset((void *)ucStack, 0, sizeof(ucStack));
+}
+
+// Grows the heap by RT_HEAP_PREFAULT and gives it back to malloc, which
+// keeps it (trimming is off) for later allocations.
+static void PrefaultHeap ()
+{
+    void *pMem = malloc(RT_HEAP_PREFAULT);
+
+    if (pMem != NULL)
+    {
+        memset(pMem, 0, RT_HEAP_PREFAULT);
+        free(pMem);
+    }
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                    R E A L - T I M E   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       EnterRealTime
+
+Description:    Switches the calling thread to real-time operation: pinned
+                to one CPU, all current and future memory locked, stack and
+                heap pre-faulted, and scheduled SCHED_FIFO. Every step is
+                tried even if an earlier one fails.
+
+Parameters:     nPriority - SCHED_FIFO priority, 1..99
+                nCpu      - CPU to run on, -1 to leave the affinity alone
+
+Return Value:   false if any step failed (the reason is printed)
+-----------------------------------------------------------------------------*/
+bool EnterRealTime (int nPriority, int nCpu)
+{
+    struct sched_param tParam;
+    cpu_set_t          tCpus;
+    bool               bOk = true;
+
+    if (nCpu >= 0)
+    {
+        CPU_ZERO(&tCpus);
+        CPU_SET(nCpu, &tCpus);
+        if (sched_setaffinity(0, sizeof(tCpus), &tCpus) != 0)
+        {
+            perror("sched_setaffinity");
+            bOk = false;
+        }
+    }
+
+    // Keep freed memory in the process, and never satisfy a malloc with a
+    // fresh mmap, which would fault in the middle of a read.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        perror("mlockall");
+        bOk = false;
+    }
+    PrefaultStack();
+    PrefaultHeap();
+
+    memset(&tParam, 0, sizeof(tParam));
+    tParam.sched_priority = nPriority;
+    if (sched_setscheduler(0, SCHED_FIFO, &tParam) != 0)
+    {
+        perror("sched_setscheduler");
+        bOk = false;
+    }
+    return bOk;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                    L A T E N C Y   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+void CLatencyStats::Add (int nLat, DBL dblMs)
+{
+    m_tMoments[nLat].Add(dblMs);
+    m_tSketch[nLat].Add(dblMs);
+}
+
+void CLatencyStats::Reset ()
+{
+    int i;
+
+    for (i = 0; i < NUM_LAT; i++)
+    {
+        m_tMoments[i].Reset();
+        m_tSketch[i].Reset();
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       BeginWait
+
+Description:    Starts a timed wait. Waits are cut to LAT_PROBE_MS so that
+                the reader wakes from its timer many times a second. With
+                the loop's own timeouts alone, a receiver sending once a
+                second would end nearly every wait with data, and the few
+                timed wake-ups would all come from silent ports.
+
+Parameters:     nTimeoutMs - the wait the loop wants, -1 for no limit
+
+Return Value:   The timeout to pass to CSerialReader::Poll().
+-----------------------------------------------------------------------------*/
+int CLatencyStats::BeginWait (int nTimeoutMs)
+{
+    if (nTimeoutMs < 0 || nTimeoutMs > LAT_PROBE_MS)
+    {
+        nTimeoutMs = LAT_PROBE_MS;
+    }
+    m_nWaitMs     = nTimeoutMs;
+    m_llWaitStart = NowNs(CLOCK_REALTIME);
+    return nTimeoutMs;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       EndWait
+
+Description:    Records how late a timed wait ended. The wake-up is the
+                time the reader took right after the wait returned, so the
+                work done on the chunks read is not counted. A wait ended
+                by data has no deadline to compare against and is not
+                measured.
+
+Parameters:     nChunks  - what CSerialReader::Poll() returned
+                llWakeNs - CSerialReader::GetWakeTime() after the Poll()
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CLatencyStats::EndWait (int nChunks, long long llWakeNs)
+{
+    long long llLate;
+
+    if (nChunks != 0 || m_nWaitMs <= 0)
+    {
+        return;
+    }
+
+    llLate = llWakeNs - m_llWaitStart - m_nWaitMs * 1000000LL;
+    if (llLate >= 0)                        // < 0: interrupted by a signal
+    {
+        Add(LAT_WAKE, llLate * 1e-6);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Measures the decode latency of every packet and the arrival
+                phase of 0x8F-AB. Packets from a parser that is not fed by
+                a CSerialReader carry no arrival time and are ignored.
+-----------------------------------------------------------------------------*/
+void CLatencyStats::OnPacket (CTsipParser *pParser,
+                              unsigned char ucPkt[], int nPktLen)
+{
+    long long llNow = NowNs(CLOCK_REALTIME);
+
+    if (pParser->GetChunkTime() == 0)
+    {
+        return;
+    }
+    Add(LAT_DECODE, (llNow - pParser->GetChunkTime()) * 1e-6);
+
+    if (nPktLen >= 5 && ucPkt[1] == CReport0x8FAB::ID &&
+        ucPkt[2] == CReport0x8FAB::SUB_ID)
+    {
+        Add(LAT_PHASE, (pParser->GetArrivalTime() % 1000000000LL) * 1e-6);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Print
+
+Description:    Prints one line per distribution, in milliseconds. For the
+                phase the spread (p99 - p1) is the figure of interest.
+
+Parameters:     strName - prefix of each line
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CLatencyStats::Print (const char *strName) const
+{
+    const CMoments          *ptMom;
+    const CQuantileSketch32 *ptSketch;
+    int i;
+
+    for (i = 0; i < NUM_LAT; i++)
+    {
+        ptMom    = &m_tMoments[i];
+        ptSketch = &m_tSketch[i];
+        if (ptMom->GetCount() == 0)
+        {
+            continue;
+        }
+        printf("%s latency %-6s n: %u  min: %.3f  max: %.3f  mean: %.3f"
+               "  sd: %.3f  p1: %.3f  p50: %.3f  p99: %.3f  p99.9: %.3f ms\n",
+               strName, gstrLatName[i], ptMom->GetCount(),
+               ptMom->GetMin(), ptMom->GetMax(), ptMom->GetMean(),
+               ptMom->GetStdDev(), ptSketch->Quantile(0.01),
+               ptSketch->Quantile(0.5), ptSketch->Quantile(0.99),
+               ptSketch->Quantile(0.999));
+    }
+}
@@ -0,0 +1,96 @@
+/*+ RtReader.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the real-time mode of the reader thread and the
+ *    measurements used to check its latency budget:
+ *
+ *    EnterRealTime() - pins the calling thread to a CPU, locks and
+ *                      pre-faults its memory and switches it to SCHED_FIFO.
+ *    CLatencyStats   - distributions of
+ *                        wake   - how late the reader wakes from a timed
+ *                                 wait (timer wake-up jitter); waits are
+ *                                 cut to LAT_PROBE_MS while measuring, so
+ *                                 most wake-ups are timed ones whatever
+ *                                 the traffic,
+ *                        decode - from the wake-up that read the last byte
+ *                                 of a packet to the packet being handed
+ *                                 to the listeners,
+ *                        phase  - where in the system clock second each
+ *                                 0x8F-AB arrives; its spread is the
+ *                                 wake-up jitter seen by the time stamps.
+ *
+ * Notes:
+ *    EnterRealTime() must be called after the ports and buffers are set
+ *    up; it needs CAP_SYS_NICE and CAP_IPC_LOCK (or root).
+ *
+-*/
+
+#ifndef RT_READER_H
+#define RT_READER_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipParser.h"
+#include "TsipStats.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define RT_DEFAULT_PRIORITY 80
+#define RT_STACK_PREFAULT   (256 * 1024)    // stack touched up front
+#define RT_HEAP_PREFAULT    (1024 * 1024)   // heap kept in the arena
+
+#define LAT_PROBE_MS        50              // longest wait while measuring
+
+#define LAT_WAKE            0
+#define LAT_DECODE          1
+#define LAT_PHASE           2
+#define NUM_LAT             3
+
+
+/*---------------------------------------------------------------------------*\
+ |                      F U N C T I O N   P R O T O T Y P E S
+\*---------------------------------------------------------------------------*/
+bool EnterRealTime (int nPriority, int nCpu);
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CLatencyStats : public CTsipListener
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CLatencyStats() : m_llWaitStart(0), m_nWaitMs(0) {};
+
+    // Bracket CSerialReader::Poll() to measure timer wake-ups.
+    int  BeginWait (int nTimeoutMs);
+    void EndWait   (int nChunks, long long llWakeNs);
+
+    void Print (const char *strName) const;
+    void Reset ();
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    void Add (int nLat, DBL dblMs);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    CMoments          m_tMoments[NUM_LAT];  // ms
+    CQuantileSketch32 m_tSketch[NUM_LAT];   // ms
+    long long         m_llWaitStart;        // ns, CLOCK_REALTIME
+    int               m_nWaitMs;
+};
+
+#endif
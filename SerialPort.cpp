@@ -0,0 +1,461 @@
+/*+ SerialPort.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements serial port configuration and TSIP baud rate
+ *    detection.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "SerialPort.h"
+#include "SerialReader.h"
+#include "TsipViews.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+static const int gnDetectBauds[] =
+{
+    9600, 19200, 38400, 57600, 115200
+};
+
+static const int gnDetectParity[] =
+{
+    PARITY_ODD, PARITY_NONE, PARITY_EVEN
+};
+
+static const char gcParityName[] = { 'N', 'O', 'E' };
+
+#define NUM_DETECT_BAUDS   (int)(sizeof(gnDetectBauds) / sizeof(gnDetectBauds[0]))
+#define NUM_DETECT_PARITY  (int)(sizeof(gnDetectParity) / sizeof(gnDetectParity[0]))
+#define NUM_CANDIDATES     (NUM_DETECT_BAUDS * NUM_DETECT_PARITY)
+
+
+/*---------------------------------------------------------------------------*\
+ |                       H E L P E R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+static speed_t BaudToSpeed (int nBaud)
+{
+    switch (nBaud)
+    {
+        case 4800:   return B4800;
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        default:     return B0;
+    }
+}
+
+static long long NowMs ()
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+    return (long long)tNow.tv_sec * 1000 + tNow.tv_nsec / 1000000;
+}
+
+// Counts the frames seen while a candidate setting is tried. A frame only
+// scores if it is a report we know with the right length: wrong settings
+// produce plenty of DLE ... DLE ETX byte runs, but not those.
+class CFrameCounter : public CTsipListener
+{
+public:
+    CFrameCounter() : m_nFrames(0), m_nValid(0), m_nErrors(0) {};
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen)
+    {
+        m_nFrames++;
+        if (CView0x8F20(ucPkt, nPktLen).IsValid() ||
+            CView0x8FAB(ucPkt, nPktLen).IsValid() ||
+            CView0x8FAC(ucPkt, nPktLen).IsValid())
+        {
+            m_nValid++;
+        }
+        else if (m_nValid > 0)
+        {
+            m_nErrors++;
+        }
+    }
+
+    int m_nFrames;                      // complete frames
+    int m_nValid;                       // known reports
+    int m_nErrors;                      // other frames after the first
+                                        // known report
+};
+
+// Tries the candidate settings on one port, one after the other. It is the
+// port's CReaderTap during detection, so all ports are probed at the same
+// time by a single reader; each candidate gets a fresh parser.
+class CPortProbe : public CReaderTap
+{
+public:
+    CPortProbe() : m_fd(-1), m_nCandidate(-1), m_llDeadline(0),
+                   m_pParser(NULL), m_bDone(false) {};
+    virtual ~CPortProbe() { delete m_pParser; }
+
+    void Start   (int fd, const PORT_SETTINGS &tSettings, int nListenMs);
+    void Check   (long long llNow, int nListenMs);
+    void Finish  ();
+
+    virtual void OnChunk (int nPort, const unsigned char ucData[], int nLen)
+    {
+        if (m_pParser != NULL)
+        {
+            m_pParser->ReceivePkt((unsigned char *)ucData, nLen);
+        }
+    }
+
+    int           m_fd;
+    int           m_nCandidate;         // index into the candidate table
+    long long     m_llDeadline;         // end of the current candidate
+    CTsipParser  *m_pParser;            // parser of the current candidate
+    CFrameCounter m_tCount;             // frames of the current candidate
+    PORT_SETTINGS m_tTry, m_tBest;
+    CFrameCounter m_tBestCount;
+    bool          m_bDone;
+
+private:
+    void Next (int nListenMs);
+};
+
+// The port falls back on tSettings unless a candidate yields a valid report.
+void CPortProbe::Start (int fd, const PORT_SETTINGS &tSettings, int nListenMs)
+{
+    m_fd             = fd;
+    m_tBest          = tSettings;
+    m_tTry.nStopBits = tSettings.nStopBits;
+    Next(nListenMs);
+}
+
+// Moves on to the next candidate that the port accepts.
+void CPortProbe::Next (int nListenMs)
+{
+    delete m_pParser;
+    m_pParser = NULL;
+
+    while (++m_nCandidate < NUM_CANDIDATES)
+    {
+        m_tTry.nBaud   = gnDetectBauds[m_nCandidate / NUM_DETECT_PARITY];
+        m_tTry.nParity = gnDetectParity[m_nCandidate % NUM_DETECT_PARITY];
+        if (PortConfigure(m_fd, m_tTry))
+        {
+            m_tCount     = CFrameCounter();
+            m_pParser    = new CTsipParser();
+            m_pParser->SetPrint(false);
+            m_pParser->AddListener(&m_tCount);
+            m_llDeadline = NowMs() + nListenMs;
+            return;
+        }
+    }
+    m_bDone = true;
+}
+
+// Scores the current candidate once it has proved itself or its time is
+// up. A candidate that already produced DETECT_GOOD_FRAMES known reports
+// and no other frames since the first of them ends the search for this
+// port. Frames before it may be left over from the previous setting.
+void CPortProbe::Check (long long llNow, int nListenMs)
+{
+    bool bGood;
+
+    if (m_bDone)
+    {
+        return;
+    }
+
+    bGood = m_tCount.m_nValid >= DETECT_GOOD_FRAMES &&
+            m_tCount.m_nErrors == 0;
+    if (!bGood && llNow < m_llDeadline)
+    {
+        return;
+    }
+
+    if (m_tCount.m_nValid > 0 &&
+        (m_tCount.m_nValid > m_tBestCount.m_nValid ||
+         (m_tCount.m_nValid == m_tBestCount.m_nValid &&
+          m_tCount.m_nFrames > m_tBestCount.m_nFrames)))
+    {
+        m_tBest      = m_tTry;
+        m_tBestCount = m_tCount;
+    }
+
+    if (bGood)
+    {
+        delete m_pParser;
+        m_pParser = NULL;
+        m_bDone   = true;
+        return;
+    }
+    Next(nListenMs);
+}
+
+// Leaves the port at the best setting found.
+void CPortProbe::Finish ()
+{
+    PortConfigure(m_fd, m_tBest);
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                      P O R T   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       PortOpen
+
+Description:    Opens a serial port for CSerialReader: non-blocking and not
+                the controlling terminal. The port is not configured.
+
+Parameters:     strDev - the device, e.g. /dev/ttyS0
+
+Return Value:   The file descriptor, or -1 (the reason is printed).
+-----------------------------------------------------------------------------*/
+int PortOpen (const char *strDev)
+{
+    int fd = open(strDev, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd == -1)
+    {
+        perror(strDev);
+    }
+    return fd;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       PortConfigure
+
+Description:    Sets the port to raw 8-bit mode with the given baud rate
+                (4800 to 230400, see BaudToSpeed), parity and stop bits.
+                With parity on, input parity checking is enabled too.
+                VMIN=1 and VTIME=0 make an empty port report EAGAIN instead
+                of a zero-length read.
+
+Parameters:     fd        - the port
+                tSettings - baud rate, parity and stop bits
+
+Return Value:   false if the baud rate is not supported or the port could
+                not be set
+-----------------------------------------------------------------------------*/
+bool PortConfigure (int fd, const PORT_SETTINGS &tSettings)
+{
+    struct termios tOpt;
+    speed_t        nSpeed = BaudToSpeed(tSettings.nBaud);
+
+    if (nSpeed == B0 || tcgetattr(fd, &tOpt) != 0)
+    {
+        return false;
+    }
+
+    tOpt.c_iflag = 0;
+    tOpt.c_oflag = 0;
+    tOpt.c_lflag = 0;
+    tOpt.c_cflag = CS8 | CREAD | CLOCAL;
+
+    if (tSettings.nParity != PARITY_NONE)
+    {
+        tOpt.c_cflag |= PARENB;
+        tOpt.c_iflag |= INPCK;
+    }
+    if (tSettings.nParity == PARITY_ODD)
+    {
+        tOpt.c_cflag |= PARODD;
+    }
+    if (tSettings.nStopBits == 2)
+    {
+        tOpt.c_cflag |= CSTOPB;
+    }
+
+    tOpt.c_cc[VTIME] = 0;
+    tOpt.c_cc[VMIN]  = 1;
+    cfsetispeed(&tOpt, nSpeed);
+    cfsetospeed(&tOpt, nSpeed);
+
+    tcflush(fd, TCIOFLUSH);
+    return tcsetattr(fd, TCSANOW, &tOpt) == 0;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       PortDetect
+
+Description:    Finds the baud rate and parity of one port; see
+                PortDetectAll().
+
+Parameters:     fd         - the port
+                nListenMs  - listening time per candidate
+                ptSettings - in: the setting to fall back on, whose stop
+                             bits are used throughout; out: the setting
+                             found
+
+Return Value:   false if no setting produced a valid report; the port is
+                then left at the setting passed in
+-----------------------------------------------------------------------------*/
+bool PortDetect (int fd, int nListenMs, PORT_SETTINGS *ptSettings)
+{
+    bool bFound;
+
+    PortDetectAll(1, &fd, nListenMs, ptSettings, &bFound);
+    return bFound;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       PortDetectAll
+
+Description:    Finds the baud rate and parity of several ports at once.
+                Each port tries 9600, 19200, 38400, 57600 and 115200 baud,
+                each with odd, no and even parity, starting with the TSIP
+                default. A candidate is listened to for up to nListenMs
+                and scored by the number of valid TSIP reports (ties go to
+                the setting with more complete frames). Candidates without
+                a valid report do not count, whatever frames they seem to
+                produce.
+
+                A port stops at the first candidate that yields
+                DETECT_GOOD_FRAMES valid reports and no bad frames, and
+                otherwise takes the best candidate. All ports are read by
+                one CSerialReader, so detecting N ports takes no longer
+                than detecting the slowest of them.
+
+                The receivers must already be sending reports, as a timing
+                receiver does once a second by default.
+
+Parameters:     nPorts      - number of ports
+                fds         - the ports
+                nListenMs   - maximum listening time per candidate
+                ptSettings  - per port, in: the setting to fall back on,
+                              whose stop bits are used throughout; out:
+                              the setting found
+                pbFound     - per port, out: false if no setting produced
+                              a valid report; the port is then left at the
+                              setting passed in
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void PortDetectAll (int nPorts, const int fds[], int nListenMs,
+                    PORT_SETTINGS ptSettings[], bool pbFound[])
+{
+    CSerialReader tReader;
+    CTsipParser   tIdle;                // the reader wants a parser per port
+    CPortProbe   *pProbes = new CPortProbe[nPorts];
+    long long     llNow, llWait;
+    int           i, nPort, nBusy;
+
+    tIdle.SetPrint(false);
+    tIdle.RejectAll();
+    if (!tReader.Open(READER_EPOLL))
+    {
+        nPorts = 0;
+    }
+
+    for (i = 0; i < nPorts; i++)
+    {
+        pProbes[i].Start(fds[i], ptSettings[i], nListenMs);
+        nPort = tReader.AddPort(fds[i], &tIdle);
+        if (nPort != -1)
+        {
+            tReader.SetTap(nPort, &pProbes[i]);
+        }
+    }
+
+    for (;;)
+    {
+        llNow  = NowMs();
+        llWait = -1;
+        nBusy  = 0;
+        for (i = 0; i < nPorts; i++)
+        {
+            pProbes[i].Check(llNow, nListenMs);
+            if (!pProbes[i].m_bDone)
+            {
+                nBusy++;
+                if (llWait < 0 || pProbes[i].m_llDeadline - llNow < llWait)
+                {
+                    llWait = pProbes[i].m_llDeadline - llNow;
+                }
+            }
+        }
+        if (nBusy == 0 || tReader.Poll((int)(llWait > 0 ? llWait : 0)) < 0)
+        {
+            break;
+        }
+    }
+
+    for (i = 0; i < nPorts; i++)
+    {
+        pProbes[i].Finish();
+        ptSettings[i] = pProbes[i].m_tBest;
+        pbFound[i]    = pProbes[i].m_tBestCount.m_nValid > 0;
+    }
+    delete [] pProbes;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       PortParse
+
+Description:    Parses a setting written as baud[:parity[:stop]], e.g.
+                "115200", "38400:n" or "9600:o:1". The baud rate is one of
+                4800, 9600, 19200, 38400, 57600, 115200 and 230400; parity
+                is n, o or e.
+                Parts left out keep their value in *ptSettings.
+
+Parameters:     strSettings - the text
+                ptSettings  - updated with the values found
+
+Return Value:   false if the text is not understood
+-----------------------------------------------------------------------------*/
+bool PortParse (const char *strSettings, PORT_SETTINGS *ptSettings)
+{
+    PORT_SETTINGS tNew = *ptSettings;
+    char         *strEnd;
+
+    tNew.nBaud = (int)strtol(strSettings, &strEnd, 10);
+    if (*strEnd == ':')
+    {
+        switch (strEnd[1] | 0x20)
+        {
+            case 'n': tNew.nParity = PARITY_NONE; break;
+            case 'o': tNew.nParity = PARITY_ODD;  break;
+            case 'e': tNew.nParity = PARITY_EVEN; break;
+            default:  return false;
+        }
+        strEnd += 2;
+    }
+    if (*strEnd == ':')
+    {
+        tNew.nStopBits = (int)strtol(strEnd + 1, &strEnd, 10);
+    }
+
+    if (*strEnd != '\0' || BaudToSpeed(tNew.nBaud) == B0 ||
+        (tNew.nStopBits != 1 && tNew.nStopBits != 2))
+    {
+        return false;
+    }
+    *ptSettings = tNew;
+    return true;
+}
+
+// Formats a setting the usual way, e.g. "9600 8O1".
+void PortFormat (const PORT_SETTINGS &tSettings, char strOut[], int nLen)
+{
+    snprintf(strOut, nLen, "%d 8%c%d", tSettings.nBaud,
+             gcParityName[tSettings.nParity], tSettings.nStopBits);
+}
@@ -0,0 +1,67 @@
+/*+ SerialPort.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the routines that open and configure the serial
+ *    port of a TSIP receiver, and detect the baud rate and parity it is
+ *    using by listening for valid TSIP reports. Detection tries 9600 to
+ *    115200 baud; a port can be configured from 4800 to 230400 baud.
+ *
+ * Notes:
+ *    Ports are opened O_NONBLOCK and configured raw with VMIN=1, as
+ *    CSerialReader requires.
+ *
+ *    Stop bits cannot be detected by listening: a UART checks only the
+ *    first stop bit of a received character. PortDetect() therefore keeps
+ *    the stop bits it is given.
+ *
+-*/
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipParser.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define PARITY_NONE       0
+#define PARITY_ODD        1
+#define PARITY_EVEN       2
+
+#define DETECT_LISTEN_MS  1200      // listening time per candidate setting
+#define DETECT_GOOD_FRAMES 2        // valid reports that end detection early
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct PORT_SETTINGS
+{
+    int nBaud;                          // 4800 .. 230400
+    int nParity;                        // PARITY_xxx
+    int nStopBits;                      // 1 or 2
+};
+
+// TSIP factory default
+static const PORT_SETTINGS gtTsipDefault = { 9600, PARITY_ODD, 1 };
+
+
+/*---------------------------------------------------------------------------*\
+ |                      F U N C T I O N   P R O T O T Y P E S
+\*---------------------------------------------------------------------------*/
+int  PortOpen      (const char *strDev);
+bool PortConfigure (int fd, const PORT_SETTINGS &tSettings);
+bool PortDetect    (int fd, int nListenMs, PORT_SETTINGS *ptSettings);
+void PortDetectAll (int nPorts, const int fds[], int nListenMs,
+                    PORT_SETTINGS ptSettings[], bool pbFound[]);
+bool PortParse     (const char *strSettings, PORT_SETTINGS *ptSettings);
+void PortFormat    (const PORT_SETTINGS &tSettings, char strOut[], int nLen);
+
+#endif
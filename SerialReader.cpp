@@ -0,0 +1,879 @@
+/*+ SerialReader.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CSerialReader class.
+ *
+ * Notes:
+ *    The io_uring backend talks to the kernel through the raw system calls
+ *    so that no extra library is needed on the target.
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "SerialReader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+
+// IORING_OP_READ_MULTISHOT (Linux 6.7) is missing from older uapi headers.
+#define OP_READ_MULTISHOT  49
+
+#define BUF_GROUP_ID       0
+
+// Marks the user_data of a completion of ArmWritable()'s poll request.
+#define USER_WRITABLE      (1ULL << 32)
+
+
+/*---------------------------------------------------------------------------*\
+ |                 I O _ U R I N G   S Y S T E M   C A L L S
+\*---------------------------------------------------------------------------*/
+static int UringSetup (unsigned nEntries, struct io_uring_params *ptParams)
+{
+    return (int)syscall(__NR_io_uring_setup, nEntries, ptParams);
+}
+
+static int UringEnter (int fd, unsigned nSubmit, unsigned nMinComplete,
+                       unsigned nFlags, void *pArg, size_t nArgSize)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, nSubmit, nMinComplete,
+                        nFlags, pArg, nArgSize);
+}
+
+static int UringRegister (int fd, unsigned nOpcode, void *pArg, unsigned nArgs)
+{
+    return (int)syscall(__NR_io_uring_register, fd, nOpcode, pArg, nArgs);
+}
+
+// Wake-up time stamp handed to the parsers. CLOCK_REALTIME, because the
+// arrival time of a timing packet is compared against the system clock.
+static long long NowNs ()
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_REALTIME, &tNow);
+    return (long long)tNow.tv_sec * 1000000000LL + tNow.tv_nsec;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T R U C T I O N   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CSerialReader::CSerialReader()
+{
+    m_nBackend    = READER_EPOLL;
+    m_nNumPorts   = 0;
+    m_llWakeNs    = 0;
+    m_nEpollFd    = -1;
+    m_nRingFd     = -1;
+    m_pSqRing     = MAP_FAILED;
+    m_pCqRing     = MAP_FAILED;
+    m_pSqes       = MAP_FAILED;
+    m_nSqRingSize = m_nCqRingSize = m_nSqesSize = 0;
+    m_nSqPending  = 0;
+    m_bExtArg     = false;
+    m_pBufRing    = NULL;
+    m_pucBufs     = NULL;
+    m_usBufTail   = 0;
+
+    memset(m_tPorts, 0, sizeof(m_tPorts));
+    memset(&m_tStats, 0, sizeof(m_tStats));
+}
+
+CSerialReader::~CSerialReader()
+{
+    Close();
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Open
+
+Description:    Sets up the selected wait backend. Ports can be added once
+                this function succeeds.
+
+Parameters:     nBackend - READER_EPOLL or READER_IO_URING
+
+Return Value:   true on success, false if the backend could not be set up
+                (e.g. io_uring is not available on this kernel).
+-----------------------------------------------------------------------------*/
+bool CSerialReader::Open (int nBackend)
+{
+    Close();
+    m_nBackend = nBackend;
+
+    switch (nBackend)
+    {
+        case READER_EPOLL:    return OpenEpoll();
+        case READER_IO_URING: return OpenUring();
+        default:              return false;
+    }
+}
+
+bool CSerialReader::OpenEpoll ()
+{
+    m_nEpollFd = epoll_create1(0);
+    if (m_nEpollFd == -1)
+    {
+        perror("epoll_create1");
+        return false;
+    }
+    return true;
+}
+
+bool CSerialReader::OpenUring ()
+{
+    struct io_uring_params  tParams;
+    struct io_uring_buf_reg tReg;
+    int                     i;
+
+    memset(&tParams, 0, sizeof(tParams));
+    m_nRingFd = UringSetup(MAX_READER_PORTS * 2, &tParams);
+    if (m_nRingFd < 0)
+    {
+        perror("io_uring_setup");
+        m_nRingFd = -1;
+        return false;
+    }
+    m_bExtArg = (tParams.features & IORING_FEAT_EXT_ARG) != 0;
+
+    // A kernel can have io_uring without multishot reads (before 6.7).
+    // Fail here so that the caller can fall back to epoll.
+    if (!ProbeMultishot())
+    {
+        fprintf(stderr, "io_uring: multishot read not supported\n");
+        Close();
+        return false;
+    }
+
+    // Map the submission and completion rings. Newer kernels place both
+    // in a single mapping.
+    m_nSqRingSize = tParams.sq_off.array + tParams.sq_entries * sizeof(unsigned);
+    m_nCqRingSize = tParams.cq_off.cqes  +
+                    tParams.cq_entries * sizeof(struct io_uring_cqe);
+    if (tParams.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (m_nCqRingSize > m_nSqRingSize)
+        {
+            m_nSqRingSize = m_nCqRingSize;
+        }
+        m_nCqRingSize = 0;
+    }
+
+    m_pSqRing = mmap(NULL, m_nSqRingSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, m_nRingFd, IORING_OFF_SQ_RING);
+    if (m_pSqRing == MAP_FAILED)
+    {
+        perror("mmap sq ring");
+        Close();
+        return false;
+    }
+
+    if (m_nCqRingSize == 0)
+    {
+        m_pCqRing = m_pSqRing;
+    }
+    else
+    {
+        m_pCqRing = mmap(NULL, m_nCqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, m_nRingFd,
+                         IORING_OFF_CQ_RING);
+        if (m_pCqRing == MAP_FAILED)
+        {
+            perror("mmap cq ring");
+            Close();
+            return false;
+        }
+    }
+
+    m_nSqesSize = tParams.sq_entries * sizeof(struct io_uring_sqe);
+    m_pSqes = mmap(NULL, m_nSqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, m_nRingFd, IORING_OFF_SQES);
+    if (m_pSqes == MAP_FAILED)
+    {
+        perror("mmap sqes");
+        Close();
+        return false;
+    }
+
+    m_pSqHead  = (unsigned *)((char *)m_pSqRing + tParams.sq_off.head);
+    m_pSqTail  = (unsigned *)((char *)m_pSqRing + tParams.sq_off.tail);
+    m_pSqMask  = (unsigned *)((char *)m_pSqRing + tParams.sq_off.ring_mask);
+    m_pSqArray = (unsigned *)((char *)m_pSqRing + tParams.sq_off.array);
+    m_pCqHead  = (unsigned *)((char *)m_pCqRing + tParams.cq_off.head);
+    m_pCqTail  = (unsigned *)((char *)m_pCqRing + tParams.cq_off.tail);
+    m_pCqMask  = (unsigned *)((char *)m_pCqRing + tParams.cq_off.ring_mask);
+    m_pCqes    = (char *)m_pCqRing + tParams.cq_off.cqes;
+
+    // Register one ring of provided buffers shared by all ports. Each
+    // multishot read picks a buffer from this ring and we hand it back
+    // as soon as the parser is done with the data.
+    if (posix_memalign(&m_pBufRing, getpagesize(),
+                       READER_NUM_BUFS * sizeof(struct io_uring_buf)) != 0)
+    {
+        m_pBufRing = NULL;
+        Close();
+        return false;
+    }
+    memset(m_pBufRing, 0, READER_NUM_BUFS * sizeof(struct io_uring_buf));
+    m_pucBufs = new unsigned char[READER_NUM_BUFS * READER_CHUNK_LEN];
+
+    memset(&tReg, 0, sizeof(tReg));
+    tReg.ring_addr    = (unsigned long)m_pBufRing;
+    tReg.ring_entries = READER_NUM_BUFS;
+    tReg.bgid         = BUF_GROUP_ID;
+    if (UringRegister(m_nRingFd, IORING_REGISTER_PBUF_RING, &tReg, 1) < 0)
+    {
+        perror("io_uring_register pbuf ring");
+        Close();
+        return false;
+    }
+
+    for (i = 0; i < READER_NUM_BUFS; i++)
+    {
+        RecycleBuf(i);
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       ProbeMultishot
+
+Description:    Asks the kernel whether it supports IORING_OP_READ_MULTISHOT.
+
+Parameters:     none
+
+Return Value:   true if the opcode is supported
+-----------------------------------------------------------------------------*/
+bool CSerialReader::ProbeMultishot ()
+{
+    struct io_uring_probe *ptProbe;
+    size_t                 nSize;
+    bool                   bSupported = false;
+
+    nSize   = sizeof(*ptProbe) + 256 * sizeof(struct io_uring_probe_op);
+    ptProbe = (struct io_uring_probe *)calloc(1, nSize);
+    if (ptProbe == NULL)
+    {
+        return false;
+    }
+
+    // The ops array follows the fixed part of the structure; it is
+    // indexed by hand for the same reason as the buffer ring.
+    if (UringRegister(m_nRingFd, IORING_REGISTER_PROBE, ptProbe, 256) == 0 &&
+        ptProbe->last_op >= OP_READ_MULTISHOT)
+    {
+        struct io_uring_probe_op *ptOps =
+            (struct io_uring_probe_op *)((char *)ptProbe + sizeof(*ptProbe));
+
+        bSupported = (ptOps[OP_READ_MULTISHOT].flags &
+                      IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(ptProbe);
+    return bSupported;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Close
+
+Description:    Releases the backend. Ports added to the reader are not
+                closed; they belong to the caller.
+
+Parameters:     none
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CSerialReader::Close ()
+{
+    if (m_nEpollFd != -1)
+    {
+        close(m_nEpollFd);
+        m_nEpollFd = -1;
+    }
+
+    if (m_pSqes != MAP_FAILED)
+    {
+        munmap(m_pSqes, m_nSqesSize);
+        m_pSqes = MAP_FAILED;
+    }
+    if (m_pCqRing != MAP_FAILED && m_pCqRing != m_pSqRing)
+    {
+        munmap(m_pCqRing, m_nCqRingSize);
+    }
+    m_pCqRing = MAP_FAILED;
+    if (m_pSqRing != MAP_FAILED)
+    {
+        munmap(m_pSqRing, m_nSqRingSize);
+        m_pSqRing = MAP_FAILED;
+    }
+    if (m_nRingFd != -1)
+    {
+        close(m_nRingFd);
+        m_nRingFd = -1;
+    }
+
+    free(m_pBufRing);
+    m_pBufRing = NULL;
+    delete [] m_pucBufs;
+    m_pucBufs   = NULL;
+    m_usBufTail = 0;
+    m_nSqPending = 0;
+    m_nNumPorts  = 0;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       AddPort
+
+Description:    Starts watching a serial port. Every chunk of data read from
+                it is passed to pParser->ReceivePkt().
+
+Parameters:     fd      - an open, non-blocking serial port
+                pParser - the parser that owns the byte stream of this port
+                bAux    - true for a helper fd (e.g. a pty) whose traffic
+                          is not counted in the reader statistics
+
+Return Value:   The port index, or -1 on failure.
+-----------------------------------------------------------------------------*/
+int CSerialReader::AddPort (int fd, CTsipParser *pParser, bool bAux)
+{
+    struct epoll_event tEvent;
+    int                nPort;
+
+    if (m_nNumPorts >= MAX_READER_PORTS)
+    {
+        return -1;
+    }
+
+    nPort = m_nNumPorts;
+    memset(&m_tPorts[nPort], 0, sizeof(READER_PORT));
+    m_tPorts[nPort].fd      = fd;
+    m_tPorts[nPort].pParser = pParser;
+    m_tPorts[nPort].bActive = true;
+    m_tPorts[nPort].bAux    = bAux;
+
+    if (m_nBackend == READER_EPOLL)
+    {
+        memset(&tEvent, 0, sizeof(tEvent));
+        tEvent.events   = EPOLLIN;
+        tEvent.data.u32 = nPort;
+        if (epoll_ctl(m_nEpollFd, EPOLL_CTL_ADD, fd, &tEvent) == -1)
+        {
+            perror("epoll_ctl");
+            return -1;
+        }
+    }
+    else if (!ArmPort(nPort))
+    {
+        return -1;
+    }
+
+    m_nNumPorts++;
+    return nPort;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Send
+
+Description:    Queues a packet for a port and writes as much of the queue
+                as the port takes now. What it does not take goes out once
+                the port is writable again, from Poll(). The queue holds
+                whole packets and is written in order, so packets from
+                different senders never interleave.
+
+Parameters:     nPort  - the port index
+                ucData - the packet, framed and stuffed
+                nLen   - its length
+
+Return Value:   false if the port is gone or the packet does not fit in the
+                queue; the packet is then dropped and counted in
+                ulSendErrors.
+-----------------------------------------------------------------------------*/
+bool CSerialReader::Send (int nPort, const U8 ucData[], int nLen)
+{
+    READER_PORT *ptPort = &m_tPorts[nPort];
+
+    // Make room at the end of the queue first.
+    if (ptPort->nOutHead > 0)
+    {
+        memmove(ptPort->ucOut, &ptPort->ucOut[ptPort->nOutHead],
+                ptPort->nOutTail - ptPort->nOutHead);
+        ptPort->nOutTail -= ptPort->nOutHead;
+        ptPort->nOutHead  = 0;
+    }
+
+    if (!ptPort->bActive || ptPort->nOutTail + nLen > READER_OUT_LEN)
+    {
+        ptPort->ulSendErrors++;
+        return false;
+    }
+    memcpy(&ptPort->ucOut[ptPort->nOutTail], ucData, nLen);
+    ptPort->nOutTail += nLen;
+
+    Flush(nPort);
+    return true;
+}
+
+int CSerialReader::GetNumActive ()
+{
+    int i, nActive = 0;
+
+    for (i = 0; i < m_nNumPorts; i++)
+    {
+        if (m_tPorts[i].bActive)
+        {
+            nActive++;
+        }
+    }
+    return nActive;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                      E V E N T   L O O P   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       Poll
+
+Description:    Waits until at least one port has data or the timeout
+                expires, then feeds everything that was read to the
+                parsers.
+
+Parameters:     nTimeoutMs - how long to wait, -1 to wait forever
+
+Return Value:   The number of chunks delivered (0 on timeout), or -1 on
+                error.
+-----------------------------------------------------------------------------*/
+int CSerialReader::Poll (int nTimeoutMs)
+{
+    if (m_nBackend == READER_IO_URING)
+    {
+        return PollUring(nTimeoutMs);
+    }
+    return PollEpoll(nTimeoutMs);
+}
+
+int CSerialReader::PollEpoll (int nTimeoutMs)
+{
+    struct epoll_event tEvents[MAX_READER_PORTS];
+    int                i, n, nPort, nRead, nChunks = 0;
+
+    n = epoll_wait(m_nEpollFd, tEvents, MAX_READER_PORTS, nTimeoutMs);
+    m_tStats.ulSyscalls++;
+    if (n < 0)
+    {
+        if (errno == EINTR)
+        {
+            return 0;
+        }
+        perror("epoll_wait");
+        return -1;
+    }
+    m_llWakeNs = NowNs();
+
+    for (i = 0; i < n; i++)
+    {
+        nPort = tEvents[i].data.u32;
+        if (tEvents[i].events & EPOLLOUT)
+        {
+            Writable(nPort);
+        }
+        if (!(tEvents[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ||
+            !m_tPorts[nPort].bActive)
+        {
+            continue;
+        }
+
+        nRead = read(m_tPorts[nPort].fd, m_ucChunk, sizeof(m_ucChunk));
+        m_tStats.ulSyscalls++;
+
+        if (nRead > 0)
+        {
+            Deliver(nPort, m_ucChunk, nRead);
+            nChunks++;
+        }
+        else if (nRead == 0 || (errno != EAGAIN && errno != EINTR))
+        {
+            DropPort(nPort, nRead == 0 ? 0 : errno);
+        }
+    }
+
+    if (nChunks > 0)
+    {
+        m_tStats.ulWakeups++;
+    }
+    return nChunks;
+}
+
+int CSerialReader::PollUring (int nTimeoutMs)
+{
+    struct io_uring_getevents_arg tArg;
+    struct __kernel_timespec      tTs;
+    struct io_uring_cqe          *ptCqe;
+    unsigned                      nHead, nTail, nFlags, nMin;
+    void                         *pArg = NULL;
+    size_t                        nArgSize = 0;
+    int                           nRet, nPort, nChunks = 0;
+
+    nHead = *m_pCqHead;
+    nTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+
+    // Only enter the kernel if there is something to submit or nothing
+    // has completed yet. A single io_uring_enter() both submits the
+    // re-armed reads and waits for data on any port.
+    if (nHead == nTail || m_nSqPending > 0)
+    {
+        nFlags = 0;
+        nMin   = 0;
+        if (nHead == nTail && nTimeoutMs != 0)
+        {
+            nFlags |= IORING_ENTER_GETEVENTS;
+            nMin    = 1;
+            if (nTimeoutMs > 0 && m_bExtArg)
+            {
+                tTs.tv_sec  = nTimeoutMs / 1000;
+                tTs.tv_nsec = (nTimeoutMs % 1000) * 1000000L;
+                memset(&tArg, 0, sizeof(tArg));
+                tArg.ts   = (unsigned long)&tTs;
+                pArg      = &tArg;
+                nArgSize  = sizeof(tArg);
+                nFlags   |= IORING_ENTER_EXT_ARG;
+            }
+        }
+
+        nRet = UringEnter(m_nRingFd, m_nSqPending, nMin, nFlags,
+                          pArg, nArgSize);
+        m_tStats.ulSyscalls++;
+        if (nRet < 0 && errno != ETIME && errno != EINTR)
+        {
+            perror("io_uring_enter");
+            return -1;
+        }
+        m_nSqPending = *m_pSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+    }
+
+    nTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+    m_llWakeNs = NowNs();
+    while (nHead != nTail)
+    {
+        ptCqe = &((struct io_uring_cqe *)m_pCqes)[nHead & *m_pCqMask];
+        nPort = (int)(ptCqe->user_data & ~USER_WRITABLE);
+
+        if (ptCqe->user_data & USER_WRITABLE)
+        {
+            Writable(nPort);
+            nHead++;
+            continue;
+        }
+
+        if (ptCqe->res > 0)
+        {
+            int nBufId = ptCqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+            Deliver(nPort, m_pucBufs + nBufId * READER_CHUNK_LEN, ptCqe->res);
+            RecycleBuf(nBufId);
+            nChunks++;
+        }
+        else if (ptCqe->res != -ENOBUFS)
+        {
+            // Zero means the port hung up; anything else is an error.
+            // Either way the multishot read is finished.
+            if (ptCqe->flags & IORING_CQE_F_BUFFER)
+            {
+                RecycleBuf(ptCqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            }
+            DropPort(nPort, -ptCqe->res);
+        }
+
+        // The kernel stops a multishot read when it runs out of provided
+        // buffers. The buffers have been handed back by now, so re-arm.
+        // If the read cannot be queued again the port would go silent, so
+        // drop it and say so instead.
+        if (!(ptCqe->flags & IORING_CQE_F_MORE) && m_tPorts[nPort].bActive &&
+            !ArmPort(nPort))
+        {
+            DropPort(nPort, EBUSY);
+        }
+        nHead++;
+    }
+    __atomic_store_n(m_pCqHead, nHead, __ATOMIC_RELEASE);
+
+    if (nChunks > 0)
+    {
+        m_tStats.ulWakeups++;
+    }
+    return nChunks;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       ArmPort
+
+Description:    Queues a multishot read on a port. The request is submitted
+                by the next io_uring_enter() made in PollUring().
+
+Parameters:     nPort - the port index
+
+Return Value:   false if the submission queue is full
+-----------------------------------------------------------------------------*/
+bool CSerialReader::ArmPort (int nPort)
+{
+    struct io_uring_sqe *ptSqe = NextSqe();
+
+    if (ptSqe == NULL)
+    {
+        return false;
+    }
+
+    ptSqe->opcode    = OP_READ_MULTISHOT;
+    ptSqe->flags     = IOSQE_BUFFER_SELECT;
+    ptSqe->fd        = m_tPorts[nPort].fd;
+    ptSqe->buf_group = BUF_GROUP_ID;
+    ptSqe->user_data = nPort;
+    PushSqe();
+    return true;
+}
+
+// Queues a one-shot poll for POLLOUT on a port, see WaitWritable().
+bool CSerialReader::ArmWritable (int nPort)
+{
+    struct io_uring_sqe *ptSqe = NextSqe();
+
+    if (ptSqe == NULL)
+    {
+        return false;
+    }
+
+    ptSqe->opcode        = IORING_OP_POLL_ADD;
+    ptSqe->fd            = m_tPorts[nPort].fd;
+    ptSqe->poll32_events = POLLOUT;
+    ptSqe->user_data     = nPort | USER_WRITABLE;
+    PushSqe();
+    return true;
+}
+
+// Returns the next free submission queue entry, cleared, or NULL if the
+// queue is full. PushSqe() hands it to the kernel.
+struct io_uring_sqe *CSerialReader::NextSqe ()
+{
+    struct io_uring_sqe *ptSqe;
+    unsigned             nTail = *m_pSqTail;
+
+    if (nTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) > *m_pSqMask)
+    {
+        return NULL;
+    }
+
+    ptSqe = &((struct io_uring_sqe *)m_pSqes)[nTail & *m_pSqMask];
+    memset(ptSqe, 0, sizeof(*ptSqe));
+    return ptSqe;
+}
+
+void CSerialReader::PushSqe ()
+{
+    unsigned nTail = *m_pSqTail;
+
+    m_pSqArray[nTail & *m_pSqMask] = nTail & *m_pSqMask;
+    __atomic_store_n(m_pSqTail, nTail + 1, __ATOMIC_RELEASE);
+    m_nSqPending++;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       RecycleBuf
+
+Description:    Hands a provided buffer back to the kernel.
+
+Parameters:     nBufId - the buffer ID reported in the completion
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CSerialReader::RecycleBuf (int nBufId)
+{
+    struct io_uring_buf_ring *ptRing = (struct io_uring_buf_ring *)m_pBufRing;
+    struct io_uring_buf      *ptBuf;
+
+    // Only addr, len and bid are written: the ring tail lives in the
+    // reserved field of the first entry. The entries are indexed by hand
+    // because the uapi flex array member is misplaced when compiled as C++.
+    ptBuf = (struct io_uring_buf *)m_pBufRing +
+            (m_usBufTail & (READER_NUM_BUFS - 1));
+    ptBuf->addr = (unsigned long)(m_pucBufs + nBufId * READER_CHUNK_LEN);
+    ptBuf->len  = READER_CHUNK_LEN;
+    ptBuf->bid  = (unsigned short)nBufId;
+    m_usBufTail++;
+
+    __atomic_store_n(&ptRing->tail, m_usBufTail, __ATOMIC_RELEASE);
+}
+
+/*-----------------------------------------------------------------------------
+Function:       WaitWritable
+
+Description:    Asks for one call to Writable() as soon as the port can take
+                more output. Used to finish a write that was cut short by
+                EAGAIN without blocking the event loop.
+
+Parameters:     nPort - the port index
+
+Return Value:   false if the request could not be queued
+-----------------------------------------------------------------------------*/
+bool CSerialReader::WaitWritable (int nPort)
+{
+    struct epoll_event tEvent;
+
+    if (!m_tPorts[nPort].bActive)
+    {
+        return false;
+    }
+    if (m_tPorts[nPort].bWantWrite)
+    {
+        return true;
+    }
+
+    if (m_nBackend == READER_EPOLL)
+    {
+        memset(&tEvent, 0, sizeof(tEvent));
+        tEvent.events   = EPOLLIN | EPOLLOUT;
+        tEvent.data.u32 = nPort;
+        if (epoll_ctl(m_nEpollFd, EPOLL_CTL_MOD, m_tPorts[nPort].fd,
+                      &tEvent) == -1)
+        {
+            perror("epoll_ctl");
+            return false;
+        }
+    }
+    else if (!ArmWritable(nPort))
+    {
+        return false;
+    }
+
+    m_tPorts[nPort].bWantWrite = true;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Flush
+
+Description:    Writes a port's queued output without blocking. What the
+                port does not take is left queued until it is writable.
+
+Parameters:     nPort - the port index
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CSerialReader::Flush (int nPort)
+{
+    READER_PORT *ptPort = &m_tPorts[nPort];
+    int          nRet;
+
+    while (ptPort->nOutHead < ptPort->nOutTail && !ptPort->bWantWrite)
+    {
+        nRet = write(ptPort->fd, &ptPort->ucOut[ptPort->nOutHead],
+                     ptPort->nOutTail - ptPort->nOutHead);
+        if (nRet > 0)
+        {
+            ptPort->nOutHead += nRet;
+        }
+        else if (nRet == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (nRet == -1 && errno == EAGAIN && WaitWritable(nPort))
+        {
+            return;
+        }
+        else
+        {
+            // The port is gone or cannot be waited on; drop the queue.
+            ptPort->ulSendErrors++;
+            break;
+        }
+    }
+    if (!ptPort->bWantWrite)
+    {
+        ptPort->nOutHead = ptPort->nOutTail = 0;
+    }
+}
+
+// Every chunk read in one wake-up carries the time of that wake-up. The
+// tap sees the raw bytes before the parser, and so before any filtering.
+void CSerialReader::Deliver (int nPort, unsigned char ucData[], int nLen)
+{
+    m_tPorts[nPort].ulReads++;
+    m_tPorts[nPort].ulBytes += nLen;
+    if (!m_tPorts[nPort].bAux)
+    {
+        m_tStats.ulReads++;
+        m_tStats.ulBytes += nLen;
+    }
+
+    if (m_tPorts[nPort].pTap != NULL)
+    {
+        m_tPorts[nPort].pTap->OnChunk(nPort, ucData, nLen);
+    }
+
+    m_tPorts[nPort].pParser->SetArrivalTime(m_llWakeNs);
+    m_tPorts[nPort].pParser->ReceivePkt(ucData, nLen);
+}
+
+// The port can take output again: drop the request and write the queue.
+void CSerialReader::Writable (int nPort)
+{
+    struct epoll_event tEvent;
+
+    if (!m_tPorts[nPort].bWantWrite)
+    {
+        return;
+    }
+    m_tPorts[nPort].bWantWrite = false;
+
+    if (m_nBackend == READER_EPOLL && m_tPorts[nPort].bActive)
+    {
+        memset(&tEvent, 0, sizeof(tEvent));
+        tEvent.events   = EPOLLIN;
+        tEvent.data.u32 = nPort;
+        epoll_ctl(m_nEpollFd, EPOLL_CTL_MOD, m_tPorts[nPort].fd, &tEvent);
+    }
+
+    if (m_tPorts[nPort].bActive)
+    {
+        Flush(nPort);
+    }
+}
+
+void CSerialReader::DropPort (int nPort, int nErr)
+{
+    if (!m_tPorts[nPort].bActive)
+    {
+        return;
+    }
+    m_tPorts[nPort].bActive = false;
+
+    if (m_nBackend == READER_EPOLL)
+    {
+        epoll_ctl(m_nEpollFd, EPOLL_CTL_DEL, m_tPorts[nPort].fd, NULL);
+    }
+
+    if (nErr)
+    {
+        fprintf(stderr, "port %d: %s\n", nPort, strerror(nErr));
+    }
+    else
+    {
+        fprintf(stderr, "port %d: hung up\n", nPort);
+    }
+}
@@ -0,0 +1,169 @@
+/*+ SerialReader.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the CSerialReader class, which waits for data on a
+ *    set of serial ports and feeds every chunk read to the CTsipParser
+ *    object attached to that port.
+ *
+ *    Two backends are available and are selected at run time:
+ *
+ *    READER_EPOLL    - one epoll_wait() per wake-up plus one read() per
+ *                      ready port.
+ *    READER_IO_URING - one multishot read is armed per port on an io_uring.
+ *                      The data lands in a ring of provided buffers that is
+ *                      registered with the kernel once, so a wake-up costs
+ *                      a single io_uring_enter() no matter how many ports
+ *                      had data.
+ *
+ *    A CReaderTap set on a port sees every chunk read from it before the
+ *    parser does. Output to a port goes through Send(), which queues whole
+ *    packets per port and writes them without blocking, so everything
+ *    that talks to a receiver shares one writer and packets from different
+ *    senders never interleave.
+ *
+ * Notes:
+ *    Ports must be opened O_NONBLOCK with VMIN=1. With VMIN=0 a tty read
+ *    returns 0 instead of EAGAIN when it is empty, which ends a multishot
+ *    read as if the port had been closed.
+ *
+-*/
+
+#ifndef SERIAL_READER_H
+#define SERIAL_READER_H
+
+#include <stddef.h>
+#include "TsipParser.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define READER_EPOLL      0
+#define READER_IO_URING   1
+
+#define MAX_READER_PORTS  64    // max number of ports per reader
+#define READER_CHUNK_LEN  512   // max bytes delivered by a single read
+#define READER_NUM_BUFS   256   // provided buffers shared by all ports
+#define READER_OUT_LEN    2048  // output queued per port
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CReaderTap;
+
+struct READER_PORT
+{
+    int          fd;
+    CTsipParser *pParser;
+    CReaderTap  *pTap;          // sees the raw chunks, may be NULL
+    bool         bActive;       // false once the port hung up or failed
+    bool         bAux;          // not counted in READER_STATS
+    bool         bWantWrite;    // WaitWritable() pending
+    U32          ulReads;       // number of chunks delivered to the parser
+    U32          ulBytes;       // number of bytes delivered to the parser
+    U8           ucOut[READER_OUT_LEN]; // packets queued by Send()
+    int          nOutHead;      // first byte not yet written
+    int          nOutTail;      // end of the queued bytes
+    U32          ulSendErrors;  // packets dropped, queue full or port failed
+};
+
+struct READER_STATS
+{
+    U32 ulSyscalls;             // system calls made by Poll()
+    U32 ulWakeups;              // Poll() calls that returned some data
+    U32 ulReads;                // chunks delivered, all but aux ports
+    U32 ulBytes;                // bytes delivered, all but aux ports
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+
+// Raw access to a port, for consumers that need the byte stream itself
+// rather than the packets the parser makes of it.
+class CReaderTap
+{
+public:
+    virtual ~CReaderTap() {};
+
+    // Called with every chunk read from the port, before the parser.
+    virtual void OnChunk (int nPort, const unsigned char ucData[], int nLen) {};
+};
+
+class CSerialReader
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CSerialReader();
+    ~CSerialReader();
+
+    bool Open    (int nBackend);
+    void Close   ();
+    int  AddPort (int fd, CTsipParser *pParser, bool bAux = false);
+    void SetTap  (int nPort, CReaderTap *pTap) { m_tPorts[nPort].pTap = pTap; }
+    bool Send    (int nPort, const U8 ucData[], int nLen);
+    int  Poll    (int nTimeoutMs);
+
+    int                 GetBackend   () { return m_nBackend; }
+    int                 GetNumPorts  () { return m_nNumPorts; }
+    int                 GetNumActive ();
+    const READER_PORT&  GetPort      (int nPort) { return m_tPorts[nPort]; }
+    const READER_STATS& GetStats     () { return m_tStats; }
+    long long           GetWakeTime  () { return m_llWakeNs; }
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    bool OpenEpoll  ();
+    bool OpenUring  ();
+    bool ProbeMultishot ();
+    int  PollEpoll  (int nTimeoutMs);
+    int  PollUring  (int nTimeoutMs);
+    bool ArmPort    (int nPort);
+    bool ArmWritable (int nPort);
+    bool WaitWritable (int nPort);
+    void Flush      (int nPort);
+    struct io_uring_sqe *NextSqe ();
+    void PushSqe    ();
+    void RecycleBuf (int nBufId);
+    void Deliver    (int nPort, unsigned char ucData[], int nLen);
+    void Writable   (int nPort);
+    void DropPort   (int nPort, int nErr);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    int           m_nBackend;
+    int           m_nNumPorts;
+    READER_PORT   m_tPorts[MAX_READER_PORTS];
+    READER_STATS  m_tStats;
+    long long     m_llWakeNs;       // CLOCK_REALTIME ns the last wait ended
+
+    // READER_EPOLL
+    int           m_nEpollFd;
+    unsigned char m_ucChunk[READER_CHUNK_LEN];
+
+    // READER_IO_URING
+    int           m_nRingFd;
+    void         *m_pSqRing;
+    void         *m_pCqRing;
+    size_t        m_nSqRingSize;
+    size_t        m_nCqRingSize;
+    void         *m_pSqes;
+    size_t        m_nSqesSize;
+    unsigned     *m_pSqHead, *m_pSqTail, *m_pSqMask, *m_pSqArray;
+    unsigned     *m_pCqHead, *m_pCqTail, *m_pCqMask;
+    void         *m_pCqes;
+    unsigned      m_nSqPending;
+    bool          m_bExtArg;
+    void         *m_pBufRing;
+    unsigned char*m_pucBufs;
+    unsigned short m_usBufTail;
+};
+
+#endif
@@ -0,0 +1,479 @@
+/*+ TsipAwait.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CTsipWaitHub class and the awaitables used
+ *    to wait for TSIP packets from coroutines.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipAwait.h"
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+
+/*---------------------------------------------------------------------------*\
+ |                       H E L P E R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+static long long NowMs ()
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+    return (long long)tNow.tv_sec * 1000 + tNow.tv_nsec / 1000000;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                     A W A I T E R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTsipPacketAwaiter::CTsipPacketAwaiter (CTsipWaitHub *pHub,
+                                        CTsipParser  *pParser,
+                                        U8            ucId,
+                                        int           nSubId,
+                                        int           nTimeoutMs,
+                                        TSIP_PACKET  *ptPkt)
+{
+    m_pHub       = pHub;
+    m_pParser    = pParser;
+    m_ucId       = ucId;
+    m_nSubId     = nSubId;
+    m_nTimeoutMs = nTimeoutMs;
+    m_ptPkt      = ptPkt;
+    m_bMatched   = false;
+    m_pReader    = NULL;
+    m_nPort      = -1;
+    m_pucCmd     = NULL;
+    m_nCmdLen    = 0;
+    m_pPort      = NULL;
+    m_pPrev      = m_pNext = NULL;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       await_suspend
+
+Description:    Registers the wait with the hub and, for a request, queues
+                the command for the port with CSerialReader::Send(). The
+                wait is registered first so that a reply arriving in the
+                same read is not missed.
+
+Parameters:     hCoro - the coroutine to resume when the wait completes
+
+Return Value:   false (do not suspend) if the parser is not attached to the
+                hub or the command could not be queued; co_await then
+                yields false at once.
+-----------------------------------------------------------------------------*/
+bool CTsipPacketAwaiter::await_suspend (std::coroutine_handle<> hCoro)
+{
+    U8 ucFramed[2 * MAX_TSIP_PKT_LEN + 4];
+    int nFramed;
+
+    m_hCoro = hCoro;
+    if (!m_pHub->AddWait(this))
+    {
+        return false;
+    }
+
+    if (m_pucCmd != NULL)
+    {
+        nFramed = CTsipParser::FramePkt(m_pucCmd[0], &m_pucCmd[1],
+                                        m_nCmdLen - 1, ucFramed);
+        if (!m_pReader->Send(m_nPort, ucFramed, nFramed))
+        {
+            m_pHub->RemoveWait(this);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                    H U B   P O R T   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTsipHubPort::CTsipHubPort (CTsipWaitHub *pHub, CTsipParser *pParser)
+{
+    m_pHub    = pHub;
+    m_pParser = pParser;
+    memset(m_pWaits, 0, sizeof(m_pWaits));
+}
+
+// A wait is for a packet the receiver sends from now on, so a replayed
+// one does not complete it.
+void CTsipHubPort::OnPacket (CTsipParser *pParser,
+                             unsigned char ucPkt[], int nPktLen)
+{
+    if (pParser->IsReplay())
+    {
+        return;
+    }
+    m_pHub->OnPacket(this, ucPkt, nPktLen);
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                    W A I T   H U B   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTsipWaitHub::CTsipWaitHub()
+{
+    m_nNumWaits = 0;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       ~CTsipWaitHub
+
+Description:    Destroys the coroutines that are still waiting; they are
+                never resumed. Then detaches from all parsers.
+-----------------------------------------------------------------------------*/
+CTsipWaitHub::~CTsipWaitHub()
+{
+    CTsipPacketAwaiter *pWait;
+    unsigned            n;
+    int                 i;
+
+    for (n = 0; n < m_tPorts.size(); n++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            while ((pWait = m_tPorts[n]->m_pWaits[i]) != NULL)
+            {
+                RemoveWait(pWait);
+                pWait->m_hCoro.destroy();
+            }
+        }
+    }
+
+    while (!m_tPorts.empty())
+    {
+        Detach(m_tPorts.back()->m_pParser);
+    }
+}
+
+bool CTsipWaitHub::Attach (CTsipParser *pParser)
+{
+    CTsipHubPort *pPort;
+
+    if (FindPort(pParser) != NULL)
+    {
+        return true;
+    }
+
+    pPort = new CTsipHubPort(this, pParser);
+    if (!pParser->AddListener(pPort))
+    {
+        delete pPort;
+        return false;
+    }
+    m_tPorts.push_back(pPort);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Detach
+
+Description:    Stops listening to a parser. Waits still registered on it
+                can no longer complete and are resumed with a false result.
+
+Parameters:     pParser - a parser attached to this hub
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipWaitHub::Detach (CTsipParser *pParser)
+{
+    CTsipHubPort       *pPort;
+    CTsipPacketAwaiter *pWait, *pDone = NULL;
+    unsigned            n;
+    int                 i;
+
+    for (n = 0; n < m_tPorts.size(); n++)
+    {
+        if (m_tPorts[n]->m_pParser == pParser)
+        {
+            break;
+        }
+    }
+    if (n == m_tPorts.size())
+    {
+        return;
+    }
+
+    pPort = m_tPorts[n];
+    m_tPorts.erase(m_tPorts.begin() + n);
+    pParser->RemoveListener(pPort);
+
+    for (i = 0; i < 256; i++)
+    {
+        while ((pWait = pPort->m_pWaits[i]) != NULL)
+        {
+            RemoveWait(pWait);
+            pWait->m_pNext = pDone;
+            pDone = pWait;
+        }
+    }
+    delete pPort;
+
+    Resume(pDone);
+}
+
+CTsipHubPort *CTsipWaitHub::FindPort (CTsipParser *pParser)
+{
+    unsigned n;
+
+    for (n = 0; n < m_tPorts.size(); n++)
+    {
+        if (m_tPorts[n]->m_pParser == pParser)
+        {
+            return m_tPorts[n];
+        }
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       NextPacket
+
+Description:    Returns an awaitable for the next packet with the given ID
+                (and 0x8F sub-packet ID) received by pParser.
+
+Parameters:     pParser    - a parser attached to this hub
+                ucId       - the packet ID
+                nSubId     - the sub-packet ID or NO_SUB_ID
+                nTimeoutMs - how long to wait, -1 to wait forever
+                ptPkt      - receives the packet (may be NULL)
+
+Return Value:   The awaitable.
+-----------------------------------------------------------------------------*/
+CTsipPacketAwaiter CTsipWaitHub::NextPacket (CTsipParser *pParser, U8 ucId,
+                                             int nSubId, int nTimeoutMs,
+                                             TSIP_PACKET *ptPkt)
+{
+    return CTsipPacketAwaiter(this, pParser, ucId, nSubId, nTimeoutMs, ptPkt);
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Request
+
+Description:    Returns an awaitable that sends a command packet to a port
+                and waits for the matching report. The command goes
+                through the reader's output queue for the port, which it
+                shares with everything else that writes to the receiver.
+
+Parameters:     pReader    - the reader the port was added to
+                nPort      - the port index; its parser must be attached
+                             to this hub
+                ucCmd      - the command: packet ID followed by its data,
+                             not stuffed. It must stay valid until the
+                             co_await expression completes.
+                nCmdLen    - number of bytes in ucCmd
+                ucId       - the ID of the expected report
+                nSubId     - the sub-packet ID of the report or NO_SUB_ID
+                nTimeoutMs - how long to wait, -1 to wait forever
+                ptPkt      - receives the report (may be NULL)
+
+Return Value:   The awaitable.
+-----------------------------------------------------------------------------*/
+CTsipPacketAwaiter CTsipWaitHub::Request (CSerialReader *pReader, int nPort,
+                                          const U8 ucCmd[], int nCmdLen,
+                                          U8 ucId, int nSubId,
+                                          int nTimeoutMs, TSIP_PACKET *ptPkt)
+{
+    CTsipPacketAwaiter tWait(this, pReader->GetPort(nPort).pParser, ucId,
+                             nSubId, nTimeoutMs, ptPkt);
+
+    tWait.m_pReader = pReader;
+    tWait.m_nPort   = nPort;
+    tWait.m_pucCmd  = ucCmd;
+    tWait.m_nCmdLen = nCmdLen;
+    return tWait;
+}
+
+bool CTsipWaitHub::AddWait (CTsipPacketAwaiter *pWait)
+{
+    CTsipHubPort *pPort;
+
+    if (pWait->m_pucCmd != NULL &&
+        (pWait->m_nCmdLen < 1 || pWait->m_nCmdLen > MAX_TSIP_PKT_LEN))
+    {
+        return false;
+    }
+
+    pPort = FindPort(pWait->m_pParser);
+    if (pPort == NULL)
+    {
+        return false;
+    }
+
+    pWait->m_pPort = pPort;
+    pWait->m_pPrev = NULL;
+    pWait->m_pNext = pPort->m_pWaits[pWait->m_ucId];
+    if (pWait->m_pNext != NULL)
+    {
+        pWait->m_pNext->m_pPrev = pWait;
+    }
+    pPort->m_pWaits[pWait->m_ucId] = pWait;
+
+    if (pWait->m_nTimeoutMs >= 0)
+    {
+        pWait->m_itDeadline = m_tDeadlines.insert(
+            make_pair(NowMs() + pWait->m_nTimeoutMs, pWait));
+    }
+    else
+    {
+        pWait->m_itDeadline = m_tDeadlines.end();
+    }
+
+    m_nNumWaits++;
+    return true;
+}
+
+void CTsipWaitHub::RemoveWait (CTsipPacketAwaiter *pWait)
+{
+    if (pWait->m_pPrev != NULL)
+    {
+        pWait->m_pPrev->m_pNext = pWait->m_pNext;
+    }
+    else
+    {
+        pWait->m_pPort->m_pWaits[pWait->m_ucId] = pWait->m_pNext;
+    }
+    if (pWait->m_pNext != NULL)
+    {
+        pWait->m_pNext->m_pPrev = pWait->m_pPrev;
+    }
+    pWait->m_pPrev = pWait->m_pNext = NULL;
+    pWait->m_pPort = NULL;
+
+    if (pWait->m_itDeadline != m_tDeadlines.end())
+    {
+        m_tDeadlines.erase(pWait->m_itDeadline);
+        pWait->m_itDeadline = m_tDeadlines.end();
+    }
+
+    m_nNumWaits--;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Completes every wait that matches a packet just received.
+                Only the waits registered on the packet's own port are
+                looked at. The matching waits are taken off the lists
+                before any of them is resumed, so a coroutine that
+                immediately waits for the same ID again gets the next
+                packet, not this one.
+
+Parameters:     pPort   - the port that received the packet
+                ucPkt   - the unstuffed packet including DLE and DLE ETX
+                nPktLen - packet length
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipWaitHub::OnPacket (CTsipHubPort *pPort,
+                             unsigned char ucPkt[], int nPktLen)
+{
+    CTsipPacketAwaiter *pWait, *pNext, *pDone = NULL;
+
+    for (pWait = pPort->m_pWaits[ucPkt[1]]; pWait != NULL; pWait = pNext)
+    {
+        pNext = pWait->m_pNext;
+        if (pWait->m_nSubId != NO_SUB_ID &&
+            (nPktLen < 5 || pWait->m_nSubId != ucPkt[2]))
+        {
+            continue;
+        }
+
+        RemoveWait(pWait);
+        pWait->m_bMatched = true;
+        if (pWait->m_ptPkt != NULL)
+        {
+            pWait->m_ptPkt->nPktLen = nPktLen;
+            memcpy(pWait->m_ptPkt->ucPkt, ucPkt, nPktLen);
+        }
+        pWait->m_pNext = pDone;
+        pDone = pWait;
+    }
+
+    Resume(pDone);
+}
+
+// Resumes a chain of completed waits, linked through m_pNext.
+void CTsipWaitHub::Resume (CTsipPacketAwaiter *pDone)
+{
+    CTsipPacketAwaiter *pWait;
+
+    while (pDone != NULL)
+    {
+        pWait = pDone;
+        pDone = pWait->m_pNext;
+        pWait->m_pNext = NULL;
+        pWait->m_hCoro.resume();
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       NextTimeoutMs
+
+Description:    Tells the event loop how long it may sleep before the next
+                wait times out.
+
+Parameters:     nMaxMs - the loop's own maximum sleep, -1 for none
+
+Return Value:   Milliseconds until the earliest deadline, capped at nMaxMs.
+-----------------------------------------------------------------------------*/
+int CTsipWaitHub::NextTimeoutMs (int nMaxMs)
+{
+    long long llWait;
+
+    if (m_tDeadlines.empty())
+    {
+        return nMaxMs;
+    }
+
+    llWait = m_tDeadlines.begin()->first - NowMs();
+    if (llWait < 0)
+    {
+        llWait = 0;
+    }
+    if (nMaxMs >= 0 && llWait > nMaxMs)
+    {
+        llWait = nMaxMs;
+    }
+    return (int)llWait;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       ExpireTimeouts
+
+Description:    Resumes, with a false result, every wait whose deadline has
+                passed.
+
+Parameters:     none
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipWaitHub::ExpireTimeouts ()
+{
+    CTsipPacketAwaiter *pWait, *pDone = NULL;
+    long long           llNow = NowMs();
+
+    while (!m_tDeadlines.empty() && m_tDeadlines.begin()->first <= llNow)
+    {
+        pWait = m_tDeadlines.begin()->second;
+        RemoveWait(pWait);
+        pWait->m_pNext = pDone;
+        pDone = pWait;
+    }
+
+    Resume(pDone);
+}
@@ -0,0 +1,211 @@
+/*+ TsipAwait.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines a C++20 coroutine interface for waiting on TSIP
+ *    packets:
+ *
+ *        CTsipTask Watch (CTsipWaitHub &hub, CTsipParser *pParser)
+ *        {
+ *            TSIP_8FAB tTime;
+ *
+ *            while (co_await hub.NextReport<CReport0x8FAB>(pParser, 2000,
+ *                                                          &tTime))
+ *            {
+ *                ...
+ *            }
+ *            // timed out
+ *        }
+ *
+ *    A suspended wait is a small record linked into the CTsipWaitHub; it
+ *    costs no thread and is only looked at when a packet with the same ID
+ *    arrives on the same port or its deadline passes. The hub is driven from the reader's
+ *    event loop:
+ *
+ *        reader.Poll(hub.NextTimeoutMs(1000));
+ *        hub.ExpireTimeouts();
+ *
+ * Notes:
+ *    Everything runs on the thread that calls CSerialReader::Poll(); the
+ *    hub is not thread safe.
+ *
+-*/
+
+#ifndef TSIP_AWAIT_H
+#define TSIP_AWAIT_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include <coroutine>
+#include <exception>
+#include <map>
+#include <vector>
+#include "TsipParser.h"
+#include "SerialReader.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct TSIP_PACKET
+{
+    int nPktLen;                        // includes DLE, ID and DLE ETX
+    U8  ucPkt[MAX_TSIP_PKT_LEN];        // unstuffed packet
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+
+// Return type of a coroutine started by the caller. The coroutine runs
+// until its first co_await immediately and frees itself when it returns.
+class CTsipTask
+{
+public:
+    struct promise_type
+    {
+        CTsipTask           get_return_object ()  { return CTsipTask(); }
+        std::suspend_never  initial_suspend ()    { return {}; }
+        std::suspend_never  final_suspend () noexcept { return {}; }
+        void                return_void ()        {}
+        void                unhandled_exception () { std::terminate(); }
+    };
+};
+
+class CTsipWaitHub;
+class CTsipHubPort;
+
+// Awaitable returned by CTsipWaitHub::NextPacket() and Request().
+// co_await yields true when a matching packet was received and false on
+// timeout.
+class CTsipPacketAwaiter
+{
+    friend class CTsipWaitHub;
+
+public:
+    CTsipPacketAwaiter (CTsipWaitHub *pHub, CTsipParser *pParser, U8 ucId,
+                        int nSubId, int nTimeoutMs, TSIP_PACKET *ptPkt);
+
+    bool await_ready   () { return false; }
+    bool await_suspend (std::coroutine_handle<> hCoro);
+    bool await_resume  () { return m_bMatched; }
+
+protected:
+    CTsipWaitHub            *m_pHub;
+    CTsipParser             *m_pParser;
+    U8                       m_ucId;
+    int                      m_nSubId;      // NO_SUB_ID matches any
+    int                      m_nTimeoutMs;  // -1 waits forever
+    TSIP_PACKET             *m_ptPkt;       // receives the packet, may be NULL
+    bool                     m_bMatched;
+
+    // Command sent to the port once the wait is registered (Request).
+    CSerialReader           *m_pReader;
+    int                      m_nPort;
+    const U8                *m_pucCmd;
+    int                      m_nCmdLen;
+
+    std::coroutine_handle<>  m_hCoro;
+    CTsipHubPort            *m_pPort;       // set while the wait is listed
+    CTsipPacketAwaiter      *m_pPrev, *m_pNext;
+    std::multimap<long long, CTsipPacketAwaiter *>::iterator m_itDeadline;
+};
+
+// Awaitable returned by CTsipWaitHub::NextReport<R>(). co_await yields true
+// when a report R was received and decoded into *ptData.
+template <class R>
+class CTsipReportAwaiter : public CTsipPacketAwaiter
+{
+public:
+    CTsipReportAwaiter (CTsipWaitHub *pHub, CTsipParser *pParser,
+                        int nTimeoutMs, typename R::Data *ptData)
+        : CTsipPacketAwaiter(pHub, pParser, R::ID, R::SUB_ID, nTimeoutMs, NULL),
+          m_ptData(ptData) {};
+
+    bool await_suspend (std::coroutine_handle<> hCoro)
+    {
+        m_ptPkt = &m_tPkt;
+        return CTsipPacketAwaiter::await_suspend(hCoro);
+    }
+
+    bool await_resume ()
+    {
+        return m_bMatched &&
+               R::Decode(&m_tPkt.ucPkt[2], m_tPkt.nPktLen - 4, m_ptData);
+    }
+
+private:
+    TSIP_PACKET       m_tPkt;
+    typename R::Data *m_ptData;
+};
+
+// A parser attached to the hub. It listens to the parser and holds the
+// waits registered on it, so a packet only visits the waits of its own port.
+class CTsipHubPort : public CTsipListener
+{
+public:
+    CTsipHubPort (CTsipWaitHub *pHub, CTsipParser *pParser);
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+    CTsipWaitHub       *m_pHub;
+    CTsipParser        *m_pParser;
+    CTsipPacketAwaiter *m_pWaits[256];      // wait lists, by packet ID
+};
+
+class CTsipWaitHub
+{
+    friend class CTsipPacketAwaiter;
+    friend class CTsipHubPort;
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CTsipWaitHub();
+    virtual ~CTsipWaitHub();
+
+    bool Attach (CTsipParser *pParser);
+    void Detach (CTsipParser *pParser);
+
+    CTsipPacketAwaiter NextPacket (CTsipParser *pParser, U8 ucId, int nSubId,
+                                   int nTimeoutMs, TSIP_PACKET *ptPkt);
+
+    template <class R>
+    CTsipReportAwaiter<R> NextReport (CTsipParser *pParser, int nTimeoutMs,
+                                      typename R::Data *ptData)
+    {
+        return CTsipReportAwaiter<R>(this, pParser, nTimeoutMs, ptData);
+    }
+
+    CTsipPacketAwaiter Request (CSerialReader *pReader, int nPort,
+                                const U8 ucCmd[], int nCmdLen,
+                                U8 ucId, int nSubId,
+                                int nTimeoutMs, TSIP_PACKET *ptPkt);
+
+    int  NextTimeoutMs  (int nMaxMs);
+    void ExpireTimeouts ();
+    int  GetNumWaits    () { return m_nNumWaits; }
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    CTsipHubPort *FindPort (CTsipParser *pParser);
+
+    bool AddWait    (CTsipPacketAwaiter *pWait);
+    void RemoveWait (CTsipPacketAwaiter *pWait);
+    void OnPacket   (CTsipHubPort *pPort, unsigned char ucPkt[], int nPktLen);
+    void Resume     (CTsipPacketAwaiter *pDone);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    std::multimap<long long, CTsipPacketAwaiter *> m_tDeadlines;
+    int                 m_nNumWaits;
+    std::vector<CTsipHubPort *> m_tPorts;   // parsers we listen to
+};
+
+#endif
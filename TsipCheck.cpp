@@ -0,0 +1,609 @@
+/*+ TsipCheck.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    Self-checks of the packet consumers, run by "make check":
+ *
+ *      - the CView accessors against the CReport decoders of
+ *        TsipReports.h, field by field on random packet contents,
+ *      - CMoments and CQuantileSketch: merging two halves gives the same
+ *        result as one pass, and every quantile is within SKETCH_ACCURACY
+ *        of the exact one,
+ *      - the CSvTable update: rises, fix counts and IODE changes counted
+ *        only while an SV stays in use,
+ *      - the CTsipHistory ring: wrap-around, Range() and a restore from
+ *        the store, with a damaged record dropped,
+ *      - the CTsipCheckpoint file: restore, replay of the restored reports
+ *        and a damaged report dropped.
+ *
+ *    Every failed check is printed; the exit status is 1 if any failed.
+ *
+ *    usage: check.out
+ *
+ * Notes:
+ *    The random packets come from a fixed-seed generator, so every run
+ *    checks the same contents.
+ *
+-*/
+
+#include     <stddef.h>
+#include     <stdio.h>
+#include     <stdlib.h>
+#include     <string.h>
+#include     <unistd.h>
+#include     <fcntl.h>
+#include     <math.h>
+
+#include "TsipParser.h"
+#include "TsipViews.h"
+#include "TsipStats.h"
+#include "TsipSvTable.h"
+#include "TsipHistory.h"
+#include "TsipCheckpoint.h"
+
+#define CHECK_PACKETS      10000    // random packets per view
+#define CHECK_SAMPLES      20000    // samples per sketch
+#define CHECK_HIST_RECS    8        // small, so that the ring wraps
+
+static int gnChecks = 0;
+static int gnFailed = 0;
+
+// Counts a check and prints it if it failed.
+static void Check(bool bOk, const char *strWhat, int nItem = -1)
+{
+    gnChecks++;
+    if(!bOk)
+    {
+        gnFailed++;
+        if(nItem >= 0)
+        {
+            printf("FAILED: %s (%d)\n", strWhat, nItem);
+        }
+        else
+        {
+            printf("FAILED: %s\n", strWhat);
+        }
+    }
+}
+
+// Fixed-seed generator, the same sequence on every platform.
+static U32 gulRandom = 12345;
+
+static U32 Random()
+{
+    gulRandom = gulRandom * 1103515245 + 12345;
+    return gulRandom >> 8;
+}
+
+// Compares two values bit for bit, so that NaNs from random bytes match.
+template <class T>
+static bool Same(T tA, T tB)
+{
+    return memcmp(&tA, &tB, sizeof(T)) == 0;
+}
+
+// Builds an unstuffed DLE 8F <sub-ID> <nLen-1 random bytes> DLE ETX.
+static int RandomPkt(U8 ucPkt[], U8 ucSubId, int nLen)
+{
+    int i;
+
+    ucPkt[0] = DLE;
+    ucPkt[1] = 0x8F;
+    ucPkt[2] = ucSubId;
+    for(i = 1; i < nLen; i++)
+    {
+        ucPkt[2 + i] = (U8)Random();
+    }
+    ucPkt[nLen + 2] = DLE;
+    ucPkt[nLen + 3] = ETX;
+    return nLen + 4;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                              V I E W S
+\*---------------------------------------------------------------------------*/
+static void CheckViews()
+{
+    U8 ucPkt[MAX_TSIP_PKT_LEN];
+    TSIP_8F20 tFix;
+    TSIP_8FAB tTime;
+    TSIP_8FAC tStat;
+    int nPktLen, n, i;
+
+    for(n = 0; n < CHECK_PACKETS; n++)
+    {
+        nPktLen = RandomPkt(ucPkt, 0x20, (n & 1) ? 64 : 56);
+        CView0x8F20 tFixView(ucPkt, nPktLen);
+        Check(tFixView.IsValid() &&
+              CReport0x8F20::Decode(&ucPkt[2], nPktLen - 4, &tFix),
+              "0x8F-20 view valid", n);
+        Check(Same(tFixView.GetTimeOfFix(), tFix.dblTimeOfFix) &&
+              Same(tFixView.GetWeekNum(), tFix.sWeekNum) &&
+              Same(tFixView.GetInfo(), tFix.ucInfo) &&
+              Same(tFixView.GetAlt(), tFix.dblAlt) &&
+              Same(tFixView.GetLat(), tFix.dblLat) &&
+              Same(tFixView.GetLon(), tFix.dblLon) &&
+              Same(tFixView.GetNumSVs(), tFix.ucNumSVs),
+              "0x8F-20 view fields", n);
+        for(i = 0; i < tFix.ucMaxSVs; i++)
+        {
+            Check(tFixView.GetSvPrn(i) == tFix.ucSvPrn[i] &&
+                  tFixView.GetSvIODE(i) == tFix.sSvIODE[i],
+                  "0x8F-20 view SV", n);
+        }
+
+        nPktLen = RandomPkt(ucPkt, 0xAB, 17);
+        CView0x8FAB tTimeView(ucPkt, nPktLen);
+        Check(tTimeView.IsValid() &&
+              CReport0x8FAB::Decode(&ucPkt[2], nPktLen - 4, &tTime),
+              "0x8F-AB view valid", n);
+        Check(tTimeView.GetTimeOfWeek() == tTime.ulTimeOfWeek &&
+              tTimeView.GetWeekNumber() == tTime.usWeekNumber &&
+              tTimeView.GetUtcOffset() == tTime.sUtcOffset &&
+              tTimeView.GetTimingFlag() == tTime.ucTimingFlag &&
+              tTimeView.GetSecond() == tTime.ucSecond &&
+              tTimeView.GetMinute() == tTime.ucMinute &&
+              tTimeView.GetHour() == tTime.ucHour &&
+              tTimeView.GetDay() == tTime.ucDay &&
+              tTimeView.GetMonth() == tTime.ucMonth &&
+              tTimeView.GetYear() == tTime.usYear,
+              "0x8F-AB view fields", n);
+
+        nPktLen = RandomPkt(ucPkt, 0xAC, 68);
+        CView0x8FAC tStatView(ucPkt, nPktLen);
+        Check(tStatView.IsValid() &&
+              CReport0x8FAC::Decode(&ucPkt[2], nPktLen - 4, &tStat),
+              "0x8F-AC view valid", n);
+        Check(tStatView.GetReceiverMode() == tStat.ucReceiverMode &&
+              tStatView.GetDiscipliningMode() == tStat.ucDiscipliningMode &&
+              tStatView.GetSelfSurveyProgress() ==
+              tStat.ucSelfSurveyProgress &&
+              tStatView.GetHoldoverDuration() == tStat.ulHoldoverDuration &&
+              tStatView.GetCriticalAlarms() == tStat.usCriticalAlarms &&
+              tStatView.GetMinorAlarms() == tStat.usMinorAlarms &&
+              tStatView.GetGPSDecodingStatus() == tStat.ucGPSDecodingStatus &&
+              tStatView.GetDiscipliningActivity() ==
+              tStat.ucDiscipliningActivity &&
+              Same(tStatView.GetPPSQuality(), tStat.fltPPSQuality) &&
+              Same(tStatView.GetTenMHzQuality(), tStat.fltTenMHzQuality) &&
+              tStatView.GetDACValue() == tStat.ulDACValue &&
+              Same(tStatView.GetDACVoltage(), tStat.fltDACVoltage) &&
+              Same(tStatView.GetTemperature(), tStat.fltTemperature) &&
+              Same(tStatView.GetLatitude(), tStat.dblLatitude) &&
+              Same(tStatView.GetLongitude(), tStat.dblLongitude) &&
+              Same(tStatView.GetAltitude(), tStat.dblAltitude),
+              "0x8F-AC view fields", n);
+    }
+
+    // A view rejects what the decoder rejects, and other reports.
+    nPktLen = RandomPkt(ucPkt, 0xAB, 18);
+    Check(!CView0x8FAB(ucPkt, nPktLen).IsValid() &&
+          !CReport0x8FAB::Decode(&ucPkt[2], nPktLen - 4, &tTime),
+          "0x8F-AB wrong length rejected");
+    nPktLen = RandomPkt(ucPkt, 0x20, 60);
+    Check(!CView0x8F20(ucPkt, nPktLen).IsValid() &&
+          !CReport0x8F20::Decode(&ucPkt[2], nPktLen - 4, &tFix),
+          "0x8F-20 wrong length rejected");
+    nPktLen = RandomPkt(ucPkt, 0xAB, 17);
+    Check(!CView0x8FAC(ucPkt, nPktLen).IsValid() &&
+          !CView0x8F20(ucPkt, nPktLen).IsValid(),
+          "0x8F-AB is not 0x8F-AC or 0x8F-20");
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                          S T A T I S T I C S
+\*---------------------------------------------------------------------------*/
+static int CompareDbl(const void *pA, const void *pB)
+{
+    DBL dblA = *(const DBL *)pA, dblB = *(const DBL *)pB;
+
+    return dblA < dblB ? -1 : dblA > dblB ? 1 : 0;
+}
+
+static void CheckStats()
+{
+    static const DBL dblQs[] = { 0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9,
+                                 0.95, 0.99, 1.0 };
+    static DBL dblSamples[CHECK_SAMPLES];
+    static DBL dblSorted[CHECK_SAMPLES];
+    CMoments tAll, tFirst, tSecond;
+    CQuantileSketch32 tSketchAll, tSketchFirst, tSketchSecond;
+    DBL dblSum = 0.0, dblVar = 0.0, dblMean, dblScale, dblExact, dblEst;
+    unsigned i;
+
+    // Magnitudes from SKETCH_MIN_VALUE to 1e4 on a log scale, both signs,
+    // as the sketch promises its accuracy on that range.
+    for(i = 0; i < CHECK_SAMPLES; i++)
+    {
+        dblSamples[i] = pow(10.0, -2.9 + 6.8 * (Random() % 100000) / 1e5);
+        if(Random() % 4 == 0)
+        {
+            dblSamples[i] = -dblSamples[i];
+        }
+        dblSum += dblSamples[i];
+
+        tAll.Add(dblSamples[i]);
+        tSketchAll.Add(dblSamples[i]);
+        if(i < CHECK_SAMPLES / 2)
+        {
+            tFirst.Add(dblSamples[i]);
+            tSketchFirst.Add(dblSamples[i]);
+        }
+        else
+        {
+            tSecond.Add(dblSamples[i]);
+            tSketchSecond.Add(dblSamples[i]);
+        }
+    }
+    dblMean = dblSum / CHECK_SAMPLES;
+    for(i = 0; i < CHECK_SAMPLES; i++)
+    {
+        dblVar += (dblSamples[i] - dblMean) * (dblSamples[i] - dblMean);
+    }
+
+    memcpy(dblSorted, dblSamples, sizeof(dblSorted));
+    qsort(dblSorted, CHECK_SAMPLES, sizeof(DBL), CompareDbl);
+    dblScale = fmax(fabs(dblSorted[0]), fabs(dblSorted[CHECK_SAMPLES - 1]));
+
+    Check(tAll.GetCount() == CHECK_SAMPLES &&
+          tAll.GetMin() == dblSorted[0] &&
+          tAll.GetMax() == dblSorted[CHECK_SAMPLES - 1] &&
+          fabs(tAll.GetMean() - dblMean) <= 1e-9 * dblScale &&
+          fabs(tAll.GetStdDev() - sqrt(dblVar / (CHECK_SAMPLES - 1))) <=
+          1e-9 * tAll.GetStdDev(),
+          "moments against two-pass");
+
+    tFirst.Merge(tSecond);
+    Check(tFirst.GetCount() == tAll.GetCount() &&
+          tFirst.GetMin() == tAll.GetMin() &&
+          tFirst.GetMax() == tAll.GetMax() &&
+          fabs(tFirst.GetMean() - tAll.GetMean()) <= 1e-9 * dblScale &&
+          fabs(tFirst.GetStdDev() - tAll.GetStdDev()) <=
+          1e-9 * tAll.GetStdDev(),
+          "moments merge");
+
+    tSketchFirst.Merge(tSketchSecond);
+    for(i = 0; i < sizeof(dblQs) / sizeof(dblQs[0]); i++)
+    {
+        dblExact = dblSorted[(unsigned)(dblQs[i] * (CHECK_SAMPLES - 1))];
+        dblEst   = tSketchAll.Quantile(dblQs[i]);
+        Check(fabs(dblEst - dblExact) <=
+              SKETCH_ACCURACY * fabs(dblExact) * (1 + 1e-9),
+              "sketch quantile within SKETCH_ACCURACY", (int)(dblQs[i] * 100));
+        Check(tSketchFirst.Quantile(dblQs[i]) == dblEst,
+              "sketch merge", (int)(dblQs[i] * 100));
+    }
+
+    tSketchAll.Reset();
+    Check(tSketchAll.Quantile(0.5) == 0.0, "empty sketch");
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                         S V   T A B L E
+\*---------------------------------------------------------------------------*/
+
+// Makes a fix at week 2380, TOW ulTow, from {PRN, IODE} pairs.
+static void MakeFix(TSIP_8F20 *ptFix, U32 ulTow, int nSVs, const int nSv[][2])
+{
+    int i;
+
+    memset(ptFix, 0, sizeof(TSIP_8F20));
+    ptFix->sWeekNum     = 2380;
+    ptFix->dblTimeOfFix = ulTow;
+    ptFix->ucMaxSVs     = 8;
+    ptFix->ucNumSVs     = (U8)nSVs;
+    for(i = 0; i < nSVs; i++)
+    {
+        ptFix->ucSvPrn[i] = (U8)nSv[i][0];
+        ptFix->sSvIODE[i] = (S16)nSv[i][1];
+    }
+}
+
+static void CheckSvTable()
+{
+    static const int nFix1[][2] = { { 5, 0x21 }, { 12, 0x22 }, { 31, 0x33 } };
+    static const int nFix2[][2] = { { 5, 0x41 }, { 12, 0x22 }, { 31, 0x33 },
+                                    { 31, 0x99 }, { 0, 0x77 } };
+    static const int nFix3[][2] = { { 5, 0x41 }, { 31, 0x33 } };
+    static const int nFix4[][2] = { { 5, 0x41 }, { 12, 0x55 }, { 31, 0x34 } };
+    CSvTable tTable;
+    TSIP_8F20 tFix;
+    const SV_STATE *ptSv;
+
+    MakeFix(&tFix, 1000, 3, nFix1);
+    tTable.Update(tFix);
+    MakeFix(&tFix, 1001, 5, nFix2);         // SV 5 new IODE, 31 twice, PRN 0
+    tTable.Update(tFix);
+    MakeFix(&tFix, 1002, 2, nFix3);         // SV 12 drops out
+    tTable.Update(tFix);
+    MakeFix(&tFix, 1003, 3, nFix4);         // SV 12 back with a new IODE
+    tTable.Update(tFix);
+
+    Check(tTable.GetNumFixes() == 4 && tTable.GetNumInUse() == 3 &&
+          tTable.GetLastFix() == GpsSecs(2380, 1003),
+          "SV table totals");
+    Check(tTable.GetSv(0) == NULL && tTable.GetSv(7) == NULL &&
+          tTable.GetSv(MAX_SV_PRN) == NULL,
+          "SV table unseen PRNs");
+
+    ptSv = tTable.GetSv(5);
+    Check(ptSv != NULL && ptSv->ulFixCount == 4 && ptSv->ulRises == 1 &&
+          ptSv->usIodeChanges == 1 && ptSv->sIODE == 0x41 &&
+          ptSv->ulFirstSeen == GpsSecs(2380, 1000) &&
+          ptSv->ulLastSeen == GpsSecs(2380, 1003),
+          "SV 5: one IODE change in use");
+
+    ptSv = tTable.GetSv(12);
+    Check(ptSv != NULL && ptSv->ulFixCount == 3 && ptSv->ulRises == 2 &&
+          ptSv->usIodeChanges == 0 && ptSv->sIODE == 0x55 && ptSv->bInUse,
+          "SV 12: new IODE after a drop-out is not a change");
+
+    ptSv = tTable.GetSv(31);
+    Check(ptSv != NULL && ptSv->ulFixCount == 4 && ptSv->ulRises == 1 &&
+          ptSv->usIodeChanges == 1 && ptSv->sIODE == 0x34,
+          "SV 31: listed twice counts once");
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                            H I S T O R Y
+\*---------------------------------------------------------------------------*/
+
+// Two packets a second for seconds 100..109 of week 2380: an 0x8F-AB
+// with the time and a 0x47 whose count byte is the packet number.
+static void FillHistory(CTsipHistory *pHist, CTsipParser *pParser)
+{
+    static U8 ucTime[] =
+    {
+        DLE, 0x8F, 0xAB, 0x00, 0x00, 0x00, 0x00, 0x09, 0x4C, 0x00, 0x12,
+        0x03, 0x00, 0x00, 0x00, 0x01, 0x01, 0x07, 0xE9, DLE, ETX
+    };
+    U8  ucLevels[] = { DLE, 0x47, 0x00, DLE, ETX };
+    U32 ulTow;
+
+    for(ulTow = 100; ulTow < 110; ulTow++)
+    {
+        ucTime[6] = (U8)ulTow;
+        pHist->OnPacket(pParser, ucTime, sizeof(ucTime));
+        ucLevels[2] = (U8)pHist->GetNextSeq();
+        pHist->OnPacket(pParser, ucLevels, sizeof(ucLevels));
+    }
+}
+
+static void CheckHistory()
+{
+    const HIST_RECORD *ptRec;
+    HIST_RECORD *ptRecords;
+    CTsipParser tParser;
+    U32 ulFirst, ulEnd, ulSeq;
+    U8 *pucStore;
+    size_t nSize;
+    int nReadable;
+
+    nSize    = (CTsipHistory::StoreSize(CHECK_HIST_RECS) + 7) & ~(size_t)7;
+    pucStore = (U8 *)aligned_alloc(8, nSize);
+
+    {
+        CTsipHistory tHist(CHECK_HIST_RECS, pucStore, false);
+
+        FillHistory(&tHist, &tParser);
+        Check(tHist.GetNextSeq() == 20 &&
+              tHist.GetGpsSecs() == GpsSecs(2380, 109),
+              "history sequence and time");
+
+        // The ring holds the last N packets, seconds 106 to 109.
+        nReadable = 0;
+        for(ulSeq = 0; ulSeq < 20; ulSeq++)
+        {
+            ptRec = tHist.GetRecord(ulSeq);
+            nReadable += ptRec != NULL;
+            Check((ptRec != NULL) == (ulSeq >= 20 - CHECK_HIST_RECS),
+                  "history wrap", ulSeq);
+        }
+        Check(nReadable == CHECK_HIST_RECS, "history holds N records");
+        Check(tHist.GetRecord(20) == NULL, "history future record");
+
+        Check(tHist.Range(GpsSecs(2380, 107), GpsSecs(2380, 108),
+                          &ulFirst, &ulEnd) && ulFirst == 14 && ulEnd == 18,
+              "history range");
+        Check(tHist.Range(0, ~0u, &ulFirst, &ulEnd) &&
+              ulFirst == 12 && ulEnd == 20,
+              "history range clipped to the ring");
+        Check(!tHist.Range(GpsSecs(2380, 100), GpsSecs(2380, 105),
+                           &ulFirst, &ulEnd),
+              "history range overwritten");
+        ptRec = tHist.Find(GpsSecs(2380, 109));
+        Check(ptRec != NULL && ptRec->ucPkt[1] == 0x8F &&
+              ptRec->ulGpsSecs == GpsSecs(2380, 109),
+              "history find");
+    }
+
+    // Damage the 0x47 of second 108 (sequence 17) in the store.
+    ptRecords = (HIST_RECORD *)(pucStore + sizeof(HIST_HEADER) +
+                                CHECK_HIST_RECS * sizeof(HIST_INDEX));
+    ptRecords[17 % CHECK_HIST_RECS].ucPkt[2] ^= 0x80;
+
+    {
+        CTsipHistory tHist(CHECK_HIST_RECS, pucStore, true);
+
+        Check(tHist.GetNextSeq() == 20 && tHist.GetGpsSecs() == 0,
+              "restored history sequence, time unknown");
+        Check(tHist.GetRecord(17) == NULL && tHist.GetRecord(16) != NULL &&
+              tHist.GetRecord(18) != NULL,
+              "restored history drops the damaged record");
+        Check(tHist.Range(GpsSecs(2380, 109), GpsSecs(2380, 109),
+                          &ulFirst, &ulEnd) && ulFirst == 18 && ulEnd == 20,
+              "restored history range");
+        Check(tHist.Range(GpsSecs(2380, 108), GpsSecs(2380, 108),
+                          &ulFirst, &ulEnd) && ulFirst == 16 && ulEnd == 17,
+              "restored history range stops at the dropped record");
+        ptRec = tHist.GetRecord(19);
+        Check(ptRec != NULL && ptRec->ucPkt[1] == 0x47 &&
+              ptRec->ucPkt[2] == 19,
+              "restored history record contents");
+    }
+
+    free(pucStore);
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                         C H E C K P O I N T
+\*---------------------------------------------------------------------------*/
+
+// Keeps the last packet handed to it and whether it was a replay.
+class CLastPacket : public CTsipListener
+{
+public:
+    int  nPkts    = 0;
+    int  nReplays = 0;
+    U8   ucLastId = 0;
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen)
+    {
+        nPkts++;
+        nReplays += pParser->IsReplay();
+        ucLastId = ucPkt[2];
+    }
+};
+
+static void CheckCheckpoint()
+{
+    char strFile[] = "/tmp/TsipCheckXXXXXX";
+    U8 ucStream[2 * MAX_TSIP_PKT_LEN], ucPkt[MAX_TSIP_PKT_LEN];
+    U8 ucData[MAX_TSIP_PKT_LEN];
+    int fd, nLen;
+
+    fd = mkstemp(strFile);
+    if(fd == -1)
+    {
+        perror("mkstemp");
+        Check(false, "checkpoint file");
+        return;
+    }
+    close(fd);
+
+    // First run: an 0x8F-AC, then an 0x8F-20, received at known times.
+    {
+        CTsipParser     tParser;
+        CTsipCheckpoint tCkpt;
+
+        tParser.SetPrint(false);
+        Check(tCkpt.Open(strFile, CHECK_HIST_RECS) && !tCkpt.IsRestored(),
+              "new checkpoint");
+        tParser.AddListener(&tCkpt);
+        tParser.AddListener(tCkpt.GetHistory());
+
+        nLen = RandomPkt(ucPkt, 0xAC, 68);
+        nLen = CTsipParser::FramePkt(0x8F, &ucPkt[2], nLen - 4, ucStream);
+        tParser.SetArrivalTime(1000000000LL);
+        tParser.ReceivePkt(ucStream, nLen);
+
+        memset(ucData, 0, sizeof(ucData));
+        ucData[0] = 0x20;
+        ucData[8] = 0x00; ucData[9] = 0x0F; ucData[10] = 0x42;
+        ucData[11] = 0x40;                  // TOW 1000 s, in ms
+        ucData[28] = 2;
+        ucData[30] = 2380 >> 8; ucData[31] = 2380 & 0xFF;
+        ucData[32] = 5;  ucData[33] = 0x21;
+        ucData[34] = 12; ucData[35] = 0x22;
+        nLen = CTsipParser::FramePkt(0x8F, ucData, 56, ucStream);
+        tParser.SetArrivalTime(2000000000LL);
+        tParser.ReceivePkt(ucStream, nLen);
+
+        Check(tCkpt.GetReport(CKPT_8FAC) != NULL &&
+              tCkpt.GetReport(CKPT_8F20) != NULL &&
+              tCkpt.GetReport(CKPT_8FAB) == NULL && tCkpt.GetPktCount() == 2,
+              "checkpoint stores the reports");
+    }
+
+    // Second run: the reports are restored and replayed, oldest first.
+    {
+        CTsipParser     tParser;
+        CTsipCheckpoint tCkpt;
+        CSvTable        tTable;
+        CLastPacket     tLast;
+        const SV_STATE *ptSv;
+
+        tParser.SetPrint(false);
+        Check(tCkpt.Open(strFile, CHECK_HIST_RECS) && tCkpt.IsRestored() &&
+              tCkpt.GetRestarts() == 1 && tCkpt.GetPktCount() == 2,
+              "checkpoint restored");
+        Check(tCkpt.IsStale(CKPT_8FAC) && tCkpt.IsStale(CKPT_8F20) &&
+              tCkpt.GetReport(CKPT_8F20)->llArrivalNs == 2000000000LL,
+              "restored reports are stale");
+        Check(tCkpt.GetHistory()->GetNextSeq() == 2 &&
+              tCkpt.GetHistory()->GetRecord(1) != NULL,
+              "checkpoint history restored");
+
+        tParser.AddListener(&tCkpt);
+        tParser.AddListener(tCkpt.GetHistory());
+        tParser.AddListener(&tTable);
+        tParser.AddListener(&tLast);
+        tCkpt.Replay(&tParser);
+
+        Check(tLast.nPkts == 2 && tLast.nReplays == 2 &&
+              tLast.ucLastId == 0x20,
+              "replay hands over both reports, oldest first");
+        Check(tCkpt.GetPktCount() == 2 &&
+              tCkpt.GetHistory()->GetNextSeq() == 2,
+              "replay is not checkpointed again");
+        Check(tParser.GetPktCount() == 0 && !tParser.IsReplay(),
+              "replay is not counted");
+        ptSv = tTable.GetSv(12);
+        Check(tTable.GetNumFixes() == 1 && ptSv != NULL &&
+              ptSv->sIODE == 0x22 && ptSv->ulLastSeen == GpsSecs(2380, 1000),
+              "SV table restored from the 0x8F-20 replay");
+
+        // A filtered parser is replayed only what it accepts.
+        tLast.nPkts = 0;
+        tParser.RejectAll();
+        tParser.Accept(0x8F, 0xAC);
+        tCkpt.Replay(&tParser);
+        Check(tLast.nPkts == 1 && tLast.ucLastId == 0xAC,
+              "replay applies the filter");
+    }
+
+    // Damage the 0x8F-20 in the file: it must not be restored.
+    fd = open(strFile, O_RDWR);
+    if(fd != -1)
+    {
+        U8 ucByte;
+
+        nLen = offsetof(CKPT_HEADER, tReports[CKPT_8F20].ucPkt) + 10;
+        if(pread(fd, &ucByte, 1, nLen) == 1)
+        {
+            ucByte ^= 0x01;
+            Check(pwrite(fd, &ucByte, 1, nLen) == 1, "damage the file");
+        }
+        close(fd);
+    }
+    {
+        CTsipCheckpoint tCkpt;
+
+        Check(tCkpt.Open(strFile, CHECK_HIST_RECS) && tCkpt.IsRestored() &&
+              tCkpt.GetReport(CKPT_8F20) == NULL &&
+              tCkpt.GetReport(CKPT_8FAC) != NULL,
+              "damaged report dropped");
+    }
+
+    unlink(strFile);
+}
+
+
+int main()
+{
+    CheckViews();
+    CheckStats();
+    CheckSvTable();
+    CheckHistory();
+    CheckCheckpoint();
+
+    printf("%d checks, %d failed\n", gnChecks, gnFailed);
+    return gnFailed > 0 ? 1 : 0;
+}
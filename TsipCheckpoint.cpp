@@ -0,0 +1,313 @@
+/*+ TsipCheckpoint.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CTsipCheckpoint warm-start file.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipCheckpoint.h"
+#include "TsipViews.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                       H E L P E R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+static long long NowNs ()
+{
+    struct timespec tNow;
+
+    clock_gettime(CLOCK_REALTIME, &tNow);
+    return (long long)tNow.tv_sec * 1000000000LL + tNow.tv_nsec;
+}
+
+static size_t HeaderSize ()
+{
+    return (sizeof(CKPT_HEADER) + 7) & ~(size_t)7;
+}
+
+static U32 ReportCheck (const CKPT_REPORT *ptRep)
+{
+    U32 ulHash;
+
+    ulHash = Fnv1a(&ptRep->usPktLen, sizeof(ptRep->usPktLen));
+    ulHash = Fnv1a(&ptRep->llArrivalNs, sizeof(ptRep->llArrivalNs), ulHash);
+    return Fnv1a(ptRep->ucPkt, ptRep->usPktLen, ulHash);
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C H E C K P O I N T   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTsipCheckpoint::CTsipCheckpoint()
+{
+    m_fd        = -1;
+    m_ptHdr     = NULL;
+    m_nSize     = 0;
+    m_bRestored = false;
+    m_llStartNs = 0;
+    m_pHistory  = NULL;
+}
+
+CTsipCheckpoint::~CTsipCheckpoint()
+{
+    Close();
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Open
+
+Description:    Maps the checkpoint file, creating it if needed. If the file
+                holds a checkpoint of the same layout it is restored,
+                without the reports and history records that fail their
+                checksum; otherwise it is cleared.
+
+Parameters:     strFile   - the file
+                nHistRecs - capacity of the history ring kept in the file,
+                            0 for none
+
+Return Value:   false if the file could not be opened or mapped (the reason
+                is printed)
+-----------------------------------------------------------------------------*/
+bool CTsipCheckpoint::Open (const char *strFile, int nHistRecs)
+{
+    struct stat tStat;
+    void       *pMap;
+    size_t      nSize;
+    int         i;
+
+    if (nHistRecs < 0)
+    {
+        nHistRecs = 0;
+    }
+    nSize = HeaderSize();
+    if (nHistRecs > 0)
+    {
+        nSize += CTsipHistory::StoreSize(nHistRecs);
+    }
+
+    m_fd = open(strFile, O_RDWR | O_CREAT, 0644);
+    if (m_fd == -1 || fstat(m_fd, &tStat) != 0)
+    {
+        perror(strFile);
+        Close();
+        return false;
+    }
+    if ((size_t)tStat.st_size != nSize && ftruncate(m_fd, nSize) != 0)
+    {
+        perror(strFile);
+        Close();
+        return false;
+    }
+
+    pMap = mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        perror("mmap");
+        Close();
+        return false;
+    }
+    m_ptHdr = (CKPT_HEADER *)pMap;
+    m_nSize = nSize;
+
+    m_bRestored = (size_t)tStat.st_size == nSize &&
+                  m_ptHdr->ulMagic == CKPT_MAGIC &&
+                  m_ptHdr->ulVersion == CKPT_VERSION &&
+                  m_ptHdr->ulHistRecs == (U32)nHistRecs;
+    if (!m_bRestored)
+    {
+        memset(m_ptHdr, 0, nSize);
+        m_ptHdr->ulMagic    = CKPT_MAGIC;
+        m_ptHdr->ulVersion  = CKPT_VERSION;
+        m_ptHdr->ulHistRecs = nHistRecs;
+    }
+    else
+    {
+        m_ptHdr->ulRestarts++;
+        for (i = 0; i < NUM_CKPT_REPORTS; i++)
+        {
+            if (m_ptHdr->tReports[i].usPktLen > MAX_TSIP_PKT_LEN ||
+                m_ptHdr->tReports[i].ulCheck !=
+                ReportCheck(&m_ptHdr->tReports[i]))
+            {
+                memset(&m_ptHdr->tReports[i], 0, sizeof(CKPT_REPORT));
+            }
+        }
+    }
+
+    if (nHistRecs > 0)
+    {
+        m_pHistory = new CTsipHistory(nHistRecs, (U8 *)m_ptHdr + HeaderSize(),
+                                      m_bRestored);
+    }
+
+    m_llStartNs = NowNs();
+    return true;
+}
+
+void CTsipCheckpoint::Close ()
+{
+    delete m_pHistory;
+    m_pHistory = NULL;
+
+    if (m_ptHdr != NULL)
+    {
+        msync(m_ptHdr, m_nSize, MS_SYNC);
+        munmap(m_ptHdr, m_nSize);
+        m_ptHdr = NULL;
+    }
+    if (m_fd != -1)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+// Writes the dirty pages back and waits for the disk.
+void CTsipCheckpoint::Sync ()
+{
+    if (m_ptHdr != NULL && msync(m_ptHdr, m_nSize, MS_SYNC) != 0)
+    {
+        perror("msync");
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       GetReport
+
+Description:    Returns the last report of a kind, from this run or restored
+                from the previous one.
+
+Parameters:     nReport - CKPT_8F20, CKPT_8FAB or CKPT_8FAC
+
+Return Value:   The report, or NULL if there is none (or the one in the file
+                failed its checksum).
+-----------------------------------------------------------------------------*/
+const CKPT_REPORT *CTsipCheckpoint::GetReport (int nReport) const
+{
+    const CKPT_REPORT *ptRep;
+
+    if (m_ptHdr == NULL || nReport < 0 || nReport >= NUM_CKPT_REPORTS)
+    {
+        return NULL;
+    }
+    ptRep = &m_ptHdr->tReports[nReport];
+    return ptRep->usPktLen == 0 ? NULL : ptRep;
+}
+
+// A report is stale if it was received before this run started.
+bool CTsipCheckpoint::IsStale (int nReport) const
+{
+    const CKPT_REPORT *ptRep = GetReport(nReport);
+
+    return ptRep == NULL || ptRep->llArrivalNs < m_llStartNs;
+}
+
+// The checksum is written last, after the report.
+/*-----------------------------------------------------------------------------
+Function:       Replay
+
+Description:    Hands the reports restored from the previous run to the
+                parser's listeners, oldest first, through
+                CTsipParser::Replay(). Call it once the listeners have been
+                added; reports received in this run are not replayed.
+
+Parameters:     pParser - the parser this checkpoint listens to
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipCheckpoint::Replay (CTsipParser *pParser)
+{
+    CKPT_REPORT tReps[NUM_CKPT_REPORTS], tRep;
+    int         nReps = 0;
+    int         i, j;
+
+    for (i = 0; i < NUM_CKPT_REPORTS; i++)
+    {
+        if (IsStale(i) && GetReport(i) != NULL)
+        {
+            tReps[nReps++] = *GetReport(i);
+        }
+    }
+    for (i = 1; i < nReps; i++)
+    {
+        tRep = tReps[i];
+        for (j = i; j > 0 && tReps[j - 1].llArrivalNs > tRep.llArrivalNs; j--)
+        {
+            tReps[j] = tReps[j - 1];
+        }
+        tReps[j] = tRep;
+    }
+
+    for (i = 0; i < nReps; i++)
+    {
+        pParser->Replay(tReps[i].ucPkt, tReps[i].usPktLen,
+                        tReps[i].llArrivalNs);
+    }
+}
+
+void CTsipCheckpoint::Store (int nReport, const U8 ucPkt[], int nPktLen,
+                             long long llNs)
+{
+    CKPT_REPORT *ptRep = &m_ptHdr->tReports[nReport];
+
+    ptRep->usPktLen    = (U16)nPktLen;
+    ptRep->llArrivalNs = llNs;
+    memcpy(ptRep->ucPkt, ucPkt, nPktLen);
+    ptRep->ulCheck     = ReportCheck(ptRep);
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Counts every packet and keeps the latest of each report
+                kind. The arrival time comes from the reader; a parser not
+                fed by a CSerialReader uses the current time. Replayed
+                packets are already in the file and are ignored.
+-----------------------------------------------------------------------------*/
+void CTsipCheckpoint::OnPacket (CTsipParser *pParser,
+                                unsigned char ucPkt[], int nPktLen)
+{
+    long long llNs;
+    int       nReport;
+
+    if (m_ptHdr == NULL || pParser->IsReplay())
+    {
+        return;
+    }
+    m_ptHdr->ulPkts++;
+
+    if (CView0x8FAB(ucPkt, nPktLen).IsValid())
+    {
+        nReport = CKPT_8FAB;
+    }
+    else if (CView0x8FAC(ucPkt, nPktLen).IsValid())
+    {
+        nReport = CKPT_8FAC;
+    }
+    else if (CView0x8F20(ucPkt, nPktLen).IsValid())
+    {
+        nReport = CKPT_8F20;
+    }
+    else
+    {
+        return;
+    }
+
+    llNs = pParser->GetArrivalTime();
+    Store(nReport, ucPkt, nPktLen, llNs != 0 ? llNs : NowNs());
+}
@@ -0,0 +1,129 @@
+/*+ TsipCheckpoint.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines CTsipCheckpoint, which keeps the latest state of a
+ *    port in a memory-mapped file so that a restarted reader has it at
+ *    once instead of waiting for the receiver's next reports:
+ *
+ *      - the last 0x8F-20, 0x8F-AB and 0x8F-AC packets and their arrival
+ *        times,
+ *      - the packet and restart counters,
+ *      - optionally the packet history ring (CTsipHistory), which then
+ *        lives in the file itself.
+ *
+ *    The file is written through the mapping as packets arrive, so a
+ *    checkpoint costs a memcpy per report and no system call; Sync()
+ *    waits until it is on the disk. The reader calls Sync() every
+ *    CKPT_SYNC_SECS and on exit, so a power failure loses at most that
+ *    much.
+ *
+ *    A report restored from the file is stale until the receiver sends
+ *    that report again; IsStale() tells the consumer. Replay() hands the
+ *    restored reports to the parser's other listeners, as packets marked
+ *    with CTsipParser::IsReplay(), so that e.g. the satellite table and
+ *    the rollups start from the receiver's last state.
+ *
+ * Notes:
+ *    Each report, and each history record, ends with a checksum written
+ *    after it. Open() drops the ones that do not match: one that was
+ *    being written when the process died, or one that the kernel had
+ *    only partly written back when the power failed.
+ *
+-*/
+
+#ifndef TSIP_CHECKPOINT_H
+#define TSIP_CHECKPOINT_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include <stddef.h>
+#include "TsipParser.h"
+#include "TsipHistory.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define CKPT_MAGIC        0x544B4354    // "TCKT"
+#define CKPT_VERSION      3
+#define CKPT_SYNC_SECS    10            // how often the reader calls Sync()
+
+#define CKPT_8F20         0
+#define CKPT_8FAB         1
+#define CKPT_8FAC         2
+#define NUM_CKPT_REPORTS  3
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct CKPT_REPORT
+{
+    U32       ulCheck;                  // Fnv1a of the rest of the report
+    U16       usPktLen;                 // 0 if never received
+    long long llArrivalNs;              // CLOCK_REALTIME ns
+    U8        ucPkt[MAX_TSIP_PKT_LEN];  // unstuffed packet
+};
+
+struct CKPT_HEADER
+{
+    U32         ulMagic;                // CKPT_MAGIC
+    U32         ulVersion;              // CKPT_VERSION
+    U32         ulHistRecs;             // history capacity, 0 for none
+    U32         ulRestarts;             // times the file was restored
+    U32         ulPkts;                 // packets seen, all runs
+    U32         ulSpare;
+    CKPT_REPORT tReports[NUM_CKPT_REPORTS];
+    // the history store follows, 8-byte aligned
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CTsipCheckpoint : public CTsipListener
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CTsipCheckpoint();
+    virtual ~CTsipCheckpoint();
+
+    bool Open  (const char *strFile, int nHistRecs);
+    void Close ();
+    void Sync  ();
+
+    bool IsRestored () const { return m_bRestored; }
+    U32  GetRestarts () const { return m_ptHdr->ulRestarts; }
+    U32  GetPktCount () const { return m_ptHdr->ulPkts; }
+
+    const CKPT_REPORT *GetReport (int nReport) const;
+    bool               IsStale   (int nReport) const;
+    void               Replay    (CTsipParser *pParser);
+
+    CTsipHistory *GetHistory () { return m_pHistory; }
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    void Store (int nReport, const U8 ucPkt[], int nPktLen, long long llNs);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    int           m_fd;
+    CKPT_HEADER  *m_ptHdr;              // the mapped file
+    size_t        m_nSize;
+    bool          m_bRestored;          // the file held a valid checkpoint
+    long long     m_llStartNs;          // reports older than this are stale
+    CTsipHistory *m_pHistory;           // ring inside the file, or NULL
+};
+
+#endif
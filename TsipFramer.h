@@ -0,0 +1,173 @@
+/*+ TsipFramer.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the TSIP framing state machine shared by CTsipParser
+ *    and the CTsipParserT template. It takes one byte of the raw serial
+ *    stream at a time, removes the DLE stuffing and collects the packet in
+ *    the caller's buffer.
+ *
+ * Notes:
+ *    The framer does not know about packet filtering. The callers look at
+ *    the ID bytes as they come in and switch the state to TSIP_SKIP to drop
+ *    the rest of an unwanted packet; the framer then only looks for its
+ *    trailing DLE ETX.
+ *
+-*/
+
+#ifndef TSIP_FRAMER_H
+#define TSIP_FRAMER_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipTypes.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define FRAME_NONE       0      // byte consumed, nothing stored
+#define FRAME_DATA       1      // byte stored in the packet buffer
+#define FRAME_END        2      // the packet buffer holds a complete packet
+#define FRAME_SKIP       3      // byte of a packet that is being skipped
+
+
+/*---------------------------------------------------------------------------*\
+ |                   F R A M I N G   S T A T E   M A C H I N E
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       TsipFrameByte
+
+Description:    Runs one byte of raw serial data through the framer.
+
+                On FRAME_END ucPkt holds DLE <id> <data> DLE ETX and nPktLen
+                its length. The state is left at TSIP_DLE; the caller hands
+                the packet on and sets nPktLen back to 0.
+
+Parameters:     ucByte      - the next byte from the serial port
+                nParseState - framer state, MSG_IN_COMPLETE initially
+                nPktLen     - number of bytes in ucPkt
+                ucPkt       - packet buffer of MAX_TSIP_PKT_LEN bytes
+
+Return Value:   FRAME_NONE, FRAME_DATA, FRAME_END or FRAME_SKIP
+-----------------------------------------------------------------------------*/
+inline int TsipFrameByte (U8 ucByte, int &nParseState, int &nPktLen,
+                          U8 ucPkt[])
+{
+    int nResult = FRAME_NONE;
+
+    switch (nParseState)
+    {
+        case MSG_IN_COMPLETE:
+            // This is the initial state in which we look for the start
+            // of the TSIP packet. We can also end up in this state if
+            // we received too many data bytes from the serial port but
+            // did not find a valid TSIP packet in that data stream.
+            //
+            // While in this state, we look for a DLE character. If we
+            // are in this state and the DLE is received, we initialize
+            // the packet buffer and transition to the next state.
+            if (ucByte == DLE)
+            {
+                nParseState      = TSIP_DLE;
+                nPktLen          = 0;
+                ucPkt[nPktLen++] = ucByte;
+                nResult          = FRAME_DATA;
+            }
+            break;
+
+        case TSIP_DLE:
+            // The parser transitions to this state if a previosly
+            // received character was DLE. Receipt of this character
+            // indicates that we may be in one of three situations:
+            //
+            //     Case 1: DLE ETX  = end of a TSIP packet
+            //     Case 2: DLE <id> = start of a TSIP packet <id>
+            //     Case 3: DLE DLE  = a DLE byte inside the packet
+            //                        (stuffed DLE byte which is a part
+            //                        of the TSIP data)
+            //
+            // If the next character is ETX (Case 1), it's the end the
+            // TSIP packet. At this point, we either have a complete TSIP
+            // packet in ucPkt or an empty packet. If we have a complete
+            // packet, return it to the caller. Otherwise, go back
+            // to the intial state and look for a valid packet again. A
+            // packet that leaves no room for the trailing DLE ETX is
+            // dropped the same way.
+            //
+            // If the next character is anything other than ETX, we
+            // add the character to the packet buffer and transition to
+            // next state to distinguish between Cases 2 and 3.
+            if (ucByte == ETX)
+            {
+                if (nPktLen > 1 && nPktLen <= MAX_TSIP_PKT_LEN - 2)
+                {
+                    ucPkt[nPktLen++] = DLE;
+                    ucPkt[nPktLen++] = ETX;
+                    return FRAME_END;
+                }
+                nParseState = MSG_IN_COMPLETE;
+            }
+            else
+            {
+                nParseState      = TSIP_IN_PARTIAL;
+                ucPkt[nPktLen++] = ucByte;
+                nResult          = FRAME_DATA;
+            }
+            break;
+
+        case TSIP_IN_PARTIAL:
+            // The parser is in this state if a previous character was
+            // a part of the TSIP data. A DLE character can be a part of
+            // the TSIP data in which case another DLE character follows
+            // it in the data stream. So on a DLE we go back to the
+            // TSIP_DLE state, and only one DLE byte is logged.
+            //
+            // All other non-DLE characters are placed in the TSIP packet
+            // buffer.
+            if (ucByte == DLE)
+            {
+                nParseState = TSIP_DLE;
+            }
+            else
+            {
+                ucPkt[nPktLen++] = ucByte;
+                nResult          = FRAME_DATA;
+            }
+            break;
+
+        case TSIP_SKIP:
+            // The packet was filtered out; only look for its end.
+            if (ucByte == DLE)
+            {
+                nParseState = TSIP_SKIP_DLE;
+            }
+            return FRAME_SKIP;
+
+        case TSIP_SKIP_DLE:
+            // DLE ETX ends the packet, DLE DLE is a stuffed data byte.
+            nParseState = (ucByte == ETX) ? MSG_IN_COMPLETE : TSIP_SKIP;
+            return FRAME_SKIP;
+
+        default:
+            nParseState = MSG_IN_COMPLETE;
+            break;
+    }
+
+    // No input message should be bigger than MAX_TSIP_PKT_LEN. If the
+    // buffer overflows we assume the end of message characters were lost,
+    // ignore this message and wait till the next message starts.
+    if (nPktLen >= MAX_TSIP_PKT_LEN)
+    {
+        nParseState = MSG_IN_COMPLETE;
+        nPktLen     = 0;
+        nResult     = FRAME_NONE;
+    }
+    return nResult;
+}
+
+#endif
@@ -0,0 +1,334 @@
+/*+ TsipHistory.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CTsipHistory packet history ring.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipHistory.h"
+#include "TsipViews.h"
+#include <stddef.h>
+#include <string.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                       H E L P E R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+// The checksum covers the record from ulSeq to the end of the packet.
+static U32 RecordCheck (const HIST_RECORD *ptRec)
+{
+    return Fnv1a(&ptRec->ulSeq, offsetof(HIST_RECORD, ucPkt) -
+                 offsetof(HIST_RECORD, ulSeq) + ptRec->usPktLen);
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                     H I S T O R Y   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTsipHistory::CTsipHistory(int nRecords)
+{
+    if (nRecords <= 0)
+    {
+        nRecords = HIST_DEFAULT_RECS;
+    }
+
+    // Zeroing touches everything now so that Add() never takes a page
+    // fault.
+    m_pucOwned = new U8[StoreSize(nRecords)];
+    Attach(nRecords, m_pucOwned, false);
+}
+
+CTsipHistory::CTsipHistory(int nRecords, void *pStore, bool bRestore)
+{
+    m_pucOwned = NULL;
+    Attach(nRecords, pStore, bRestore);
+}
+
+CTsipHistory::~CTsipHistory()
+{
+    delete[] m_pucOwned;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       StoreSize
+
+Description:    Returns the number of bytes needed to hold a ring of
+                nRecords records, its index and its header.
+-----------------------------------------------------------------------------*/
+size_t CTsipHistory::StoreSize (int nRecords)
+{
+    return sizeof(HIST_HEADER) + nRecords * sizeof(HIST_INDEX) +
+           nRecords * sizeof(HIST_RECORD);
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Attach
+
+Description:    Lays the header, index and records out in the store. When
+                restoring, the records and index are kept but the current
+                time is forgotten: until the next timing report arrives,
+                new packets are not stamped with a time from before the
+                restart. The newest indexed second is kept, so Range() can
+                search the restored records straight away, and the records
+                that fail their checksum are dropped.
+
+Parameters:     nRecords - the capacity
+                pStore   - StoreSize(nRecords) bytes, 8-byte aligned
+                bRestore - keep the contents of the store
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipHistory::Attach (int nRecords, void *pStore, bool bRestore)
+{
+    m_nRecords  = nRecords;
+    m_ptHdr     = (HIST_HEADER *)pStore;
+    m_ptIndex   = (HIST_INDEX *)(m_ptHdr + 1);
+    m_ptRecords = (HIST_RECORD *)(m_ptIndex + nRecords);
+
+    if (!bRestore || m_ptHdr->ulRecords != (U32)nRecords)
+    {
+        memset(pStore, 0, StoreSize(nRecords));
+        m_ptHdr->ulRecords = nRecords;
+    }
+    else
+    {
+        Verify();
+    }
+    m_ptHdr->ulGpsSecs = 0;
+    m_ptHdr->ulHaveAB  = 0;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Verify
+
+Description:    Clears the restored records whose checksum does not match:
+                one that was being written when the process died, or, after
+                a power failure, one that only partly reached the disk.
+                GetRecord() does not return a cleared record.
+-----------------------------------------------------------------------------*/
+void CTsipHistory::Verify ()
+{
+    HIST_RECORD *ptRec;
+    int          i;
+
+    for (i = 0; i < m_nRecords; i++)
+    {
+        ptRec = &m_ptRecords[i];
+        if (ptRec->usPktLen > MAX_TSIP_PKT_LEN ||
+            ptRec->ulCheck != RecordCheck(ptRec))
+        {
+            memset(ptRec, 0, sizeof(HIST_RECORD));
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Add
+
+Description:    Appends a packet to the ring, overwriting the oldest record
+                once the ring is full, and stamps it with the current GPS
+                second. In a caller's store the checksum is written last,
+                after the record.
+
+Parameters:     ucPkt   - the unstuffed packet including DLE and DLE ETX
+                nPktLen - packet length
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipHistory::Add (const U8 ucPkt[], int nPktLen)
+{
+    HIST_RECORD *ptRec = &m_ptRecords[m_ptHdr->ulSeq % m_nRecords];
+
+    if (nPktLen > MAX_TSIP_PKT_LEN)
+    {
+        nPktLen = MAX_TSIP_PKT_LEN;
+    }
+
+    ptRec->ulSeq     = m_ptHdr->ulSeq;
+    ptRec->ulGpsSecs = m_ptHdr->ulGpsSecs;
+    ptRec->usPktLen  = (U16)nPktLen;
+    memcpy(ptRec->ucPkt, ucPkt, nPktLen);
+    if (m_pucOwned == NULL)
+    {
+        ptRec->ulCheck = RecordCheck(ptRec);
+    }
+    m_ptHdr->ulSeq++;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       SetTime
+
+Description:    Moves the time stamp on to a new GPS second and points that
+                second's index slot at the next record.
+
+Parameters:     ulGpsSecs - the new time
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipHistory::SetTime (U32 ulGpsSecs)
+{
+    HIST_INDEX *ptIdx;
+
+    if (ulGpsSecs == m_ptHdr->ulGpsSecs || ulGpsSecs == 0)
+    {
+        return;
+    }
+
+    ptIdx = &m_ptIndex[ulGpsSecs % m_nRecords];
+    ptIdx->ulGpsSecs  = ulGpsSecs;
+    ptIdx->ulFirstSeq = m_ptHdr->ulSeq;
+    m_ptHdr->ulGpsSecs  = ulGpsSecs;
+    m_ptHdr->ulLastSecs = ulGpsSecs;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       GetRecord
+
+Description:    Returns a record by sequence number.
+
+Parameters:     ulSeq - the sequence number (0 is the first packet received)
+
+Return Value:   A pointer into the ring, or NULL if the record has not been
+                received yet, has been overwritten or was dropped by a
+                restore.
+-----------------------------------------------------------------------------*/
+const HIST_RECORD *CTsipHistory::GetRecord (U32 ulSeq) const
+{
+    const HIST_RECORD *ptRec = &m_ptRecords[ulSeq % m_nRecords];
+    U32                ulAge = m_ptHdr->ulSeq - ulSeq;
+
+    if (ulAge == 0 || ulAge > (U32)m_nRecords || ulAge > m_ptHdr->ulSeq ||
+        ptRec->ulSeq != ulSeq || ptRec->usPktLen == 0)
+    {
+        return NULL;
+    }
+    return ptRec;
+}
+
+const HIST_INDEX *CTsipHistory::Lookup (U32 ulGpsSecs) const
+{
+    const HIST_INDEX  *ptIdx = &m_ptIndex[ulGpsSecs % m_nRecords];
+    const HIST_RECORD *ptRec;
+
+    if (ulGpsSecs == 0 || ptIdx->ulGpsSecs != ulGpsSecs ||
+        (ptRec = GetRecord(ptIdx->ulFirstSeq)) == NULL ||
+        ptRec->ulGpsSecs != ulGpsSecs)
+    {
+        return NULL;
+    }
+    return ptIdx;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Find
+
+Description:    Returns the first packet stamped with a GPS second.
+
+Parameters:     ulGpsSecs - the second, see GpsSecs()
+
+Return Value:   A pointer into the ring, or NULL if the second is not in it.
+-----------------------------------------------------------------------------*/
+const HIST_RECORD *CTsipHistory::Find (U32 ulGpsSecs) const
+{
+    const HIST_INDEX *ptIdx = Lookup(ulGpsSecs);
+
+    return ptIdx != NULL ? GetRecord(ptIdx->ulFirstSeq) : NULL;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Range
+
+Description:    Finds the records stamped with a time in [ulFrom, ulTo].
+                Only the seconds held by the index, the N seconds up to
+                the newest one, are looked at to find the start, and the
+                records themselves to find the end, so the cost is bounded
+                by the ring size and the result.
+
+Parameters:     ulFrom, ulTo - the time range, in GPS seconds
+                pulFirst     - receives the sequence of the first record
+                pulEnd       - receives the sequence after the last record
+
+Return Value:   false if no record in the ring falls in the range
+-----------------------------------------------------------------------------*/
+bool CTsipHistory::Range (U32 ulFrom, U32 ulTo,
+                          U32 *pulFirst, U32 *pulEnd) const
+{
+    const HIST_INDEX  *ptIdx = NULL;
+    const HIST_RECORD *ptRec;
+    U32 ulLast = m_ptHdr->ulLastSecs;
+    U32 ulSecs, ulSeq;
+
+    if (ulLast == 0 || ulFrom > ulTo)
+    {
+        return false;
+    }
+
+    if (ulLast >= (U32)m_nRecords && ulFrom <= ulLast - m_nRecords)
+    {
+        ulFrom = ulLast - m_nRecords + 1;
+    }
+    if (ulTo > ulLast)
+    {
+        ulTo = ulLast;
+    }
+
+    for (ulSecs = ulFrom; ulSecs <= ulTo && ptIdx == NULL; ulSecs++)
+    {
+        ptIdx = Lookup(ulSecs);
+    }
+    if (ptIdx == NULL)
+    {
+        return false;
+    }
+
+    ulSeq = ptIdx->ulFirstSeq;
+    while ((ptRec = GetRecord(ulSeq)) != NULL && ptRec->ulGpsSecs <= ulTo &&
+           ptRec->ulGpsSecs >= ulFrom)
+    {
+        ulSeq++;
+    }
+
+    *pulFirst = ptIdx->ulFirstSeq;
+    *pulEnd   = ulSeq;
+    return ulSeq != ptIdx->ulFirstSeq;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Records every packet received by the parser. The time stamp
+                comes from 0x8F-AB; a receiver that only sends 0x8F-20 fixes
+                is stamped with the time of fix instead. Replayed packets
+                are not recorded again.
+-----------------------------------------------------------------------------*/
+void CTsipHistory::OnPacket (CTsipParser *pParser,
+                             unsigned char ucPkt[], int nPktLen)
+{
+    CView0x8FAB tTime(ucPkt, nPktLen);
+    CView0x8F20 tFix(ucPkt, nPktLen);
+
+    if (pParser->IsReplay())
+    {
+        return;
+    }
+    if (tTime.IsValid())
+    {
+        m_ptHdr->ulHaveAB = 1;
+        SetTime(GpsSecs(tTime.GetWeekNumber(), tTime.GetTimeOfWeek()));
+    }
+    else if (!m_ptHdr->ulHaveAB && tFix.IsValid())
+    {
+        SetTime(GpsSecs((U16)tFix.GetWeekNum(), (U32)tFix.GetTimeOfFix()));
+    }
+
+    Add(ucPkt, nPktLen);
+}
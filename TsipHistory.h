@@ -0,0 +1,149 @@
+/*+ TsipHistory.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines CTsipHistory, a preallocated ring of the last N
+ *    packets received by a parser. Every packet is stamped with the GPS
+ *    time of the most recent 0x8F-AB or 0x8F-20 report, and a second ring
+ *    indexed by GPS second gives the first packet stamped with that
+ *    second, so "the packets at week W, TOW T" is two array lookups:
+ *
+ *        U32 ulFirst, ulEnd, ulSeq;
+ *
+ *        if (hist.Range(GpsSecs(W, T), GpsSecs(W, T), &ulFirst, &ulEnd))
+ *            for (ulSeq = ulFirst; ulSeq != ulEnd; ulSeq++)
+ *                Use(hist.GetRecord(ulSeq));
+ *
+ *    Records are returned as pointers into the ring; a record stays valid
+ *    until N more packets have been received.
+ *
+ *    The ring normally lives on the heap, but can be placed in memory
+ *    supplied by the caller (StoreSize() bytes), e.g. a memory-mapped
+ *    checkpoint file, so that it survives a restart. A restored history
+ *    can be searched by time at once, before the next timing report.
+ *    Records in such a store carry a checksum, and a restore drops those
+ *    that were not completely written.
+ *
+ * Notes:
+ *    Packets received before the first timing report are kept in the ring
+ *    but have no time and cannot be looked up by time. The index holds the
+ *    last N seconds, so with fewer than one packet a second some older
+ *    records can only be reached by sequence number.
+ *
+-*/
+
+#ifndef TSIP_HISTORY_H
+#define TSIP_HISTORY_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include <stddef.h>
+#include "TsipParser.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define HIST_DEFAULT_RECS 4096      // about 20 minutes of a timing receiver
+
+// GPS seconds since the start of week 0, the key of the history index
+static inline U32 GpsSecs (U16 usWeek, U32 ulTimeOfWeek)
+{
+    return (U32)usWeek * SECS_PER_WEEK + ulTimeOfWeek;
+}
+
+// FNV-1a hash, the checksum of the records kept in a checkpoint file;
+// ulHash continues the hash of a preceding block
+static inline U32 Fnv1a (const void *pData, size_t nLen,
+                         U32 ulHash = 2166136261u)
+{
+    const U8 *pucData = (const U8 *)pData;
+
+    while (nLen-- > 0)
+    {
+        ulHash = (ulHash ^ *pucData++) * 16777619u;
+    }
+    return ulHash;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct HIST_RECORD
+{
+    U32 ulCheck;                        // Fnv1a of the rest, in a file store
+    U32 ulSeq;                          // sequence number of the packet
+    U32 ulGpsSecs;                      // time stamp, 0 if not yet known
+    U16 usPktLen;                       // includes DLE, ID and DLE ETX
+    U8  ucPkt[MAX_TSIP_PKT_LEN];        // unstuffed packet
+};
+
+struct HIST_INDEX
+{
+    U32 ulGpsSecs;                      // the second this slot holds
+    U32 ulFirstSeq;                     // first record stamped with it
+};
+
+// Start of the store; followed by the index and then the records.
+struct HIST_HEADER
+{
+    U32 ulRecords;                      // capacity of both rings
+    U32 ulSeq;                          // sequence of the next record
+    U32 ulGpsSecs;                      // current time stamp, 0: unknown
+    U32 ulHaveAB;                       // 0x8F-AB seen; ignore 0x8F-20 time
+    U32 ulLastSecs;                     // newest second in the index, kept
+                                        // across a restore
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CTsipHistory : public CTsipListener
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CTsipHistory(int nRecords = HIST_DEFAULT_RECS);
+    CTsipHistory(int nRecords, void *pStore, bool bRestore);
+    virtual ~CTsipHistory();
+
+    static size_t StoreSize (int nRecords);
+
+    void Add (const U8 ucPkt[], int nPktLen);
+
+    const HIST_RECORD *Find      (U32 ulGpsSecs) const;
+    bool               Range     (U32 ulFrom, U32 ulTo,
+                                  U32 *pulFirst, U32 *pulEnd) const;
+    const HIST_RECORD *GetRecord (U32 ulSeq) const;
+
+    int GetCapacity () const { return m_nRecords; }
+    U32 GetNextSeq  () const { return m_ptHdr->ulSeq; }
+    U32 GetGpsSecs  () const { return m_ptHdr->ulGpsSecs; }
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    void              Attach  (int nRecords, void *pStore, bool bRestore);
+    void              Verify  ();
+    const HIST_INDEX *Lookup  (U32 ulGpsSecs) const;
+    void              SetTime (U32 ulGpsSecs);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    int          m_nRecords;            // capacity of both rings
+    HIST_HEADER *m_ptHdr;               // sequence and time, in the store
+    HIST_RECORD *m_ptRecords;           // indexed by sequence % m_nRecords
+    HIST_INDEX  *m_ptIndex;             // indexed by GPS second % m_nRecords
+    U8          *m_pucOwned;            // the store, if allocated here
+};
+
+#endif
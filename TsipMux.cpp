@@ -0,0 +1,297 @@
+/*+ TsipMux.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CTsipMux pseudo-terminal multiplexer.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipMux.h"
+#include "TsipFramer.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                         M U X   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTsipMux::CTsipMux(CSerialReader *pReader, int nPort)
+{
+    m_pReader     = pReader;
+    m_nPort       = nPort;
+    m_nNumPtys    = 0;
+    m_nFrameState = MSG_IN_COMPLETE;
+    m_nFrameLen   = 0;
+    m_nRawLen     = 0;
+    memset(m_tPtys, 0, sizeof(m_tPtys));
+
+    m_pReader->SetTap(m_nPort, this);
+}
+
+/*-----------------------------------------------------------------------------
+Function:       ~CTsipMux
+
+Description:    Closes the ptys. Any CSerialReader still polling a master fd
+                must have been closed first.
+-----------------------------------------------------------------------------*/
+CTsipMux::~CTsipMux()
+{
+    int i;
+
+    m_pReader->SetTap(m_nPort, NULL);
+    for (i = 0; i < m_nNumPtys; i++)
+    {
+        close(m_tPtys[i].fdMaster);
+        close(m_tPtys[i].fdSlave);
+        delete m_tPtys[i].pParser;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       AddPty
+
+Description:    Creates a pseudo-terminal in raw mode for one more consumer.
+                The caller adds its fdMaster and pParser to the reader.
+
+Parameters:     none
+
+Return Value:   The index of the new pty, or -1 on error.
+-----------------------------------------------------------------------------*/
+int CTsipMux::AddPty ()
+{
+    MUX_PTY       *ptPty;
+    struct termios tOpt;
+    const char    *strSlave;
+    int            fdMaster, fdSlave;
+
+    if (m_nNumPtys >= MAX_MUX_PTYS)
+    {
+        return -1;
+    }
+
+    fdMaster = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fdMaster == -1 || grantpt(fdMaster) != 0 || unlockpt(fdMaster) != 0 ||
+        (strSlave = ptsname(fdMaster)) == NULL)
+    {
+        perror("posix_openpt");
+        if (fdMaster != -1)
+        {
+            close(fdMaster);
+        }
+        return -1;
+    }
+
+    fdSlave = open(strSlave, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fdSlave == -1)
+    {
+        perror(strSlave);
+        close(fdMaster);
+        return -1;
+    }
+
+    // TSIP is binary; no echo, no line discipline processing.
+    tcgetattr(fdSlave, &tOpt);
+    cfmakeraw(&tOpt);
+    tOpt.c_cc[VMIN]  = 1;
+    tOpt.c_cc[VTIME] = 0;
+    tcsetattr(fdSlave, TCSANOW, &tOpt);
+
+    ptPty = &m_tPtys[m_nNumPtys];
+    ptPty->fdMaster = fdMaster;
+    ptPty->fdSlave  = fdSlave;
+    ptPty->pParser  = new CTsipParser();
+    ptPty->pParser->SetPrint(false);
+    ptPty->pParser->AddListener(this);
+    snprintf(ptPty->strName, MUX_NAME_LEN, "%s", strSlave);
+
+    return m_nNumPtys++;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    A packet from a pty is a command for the port. It is framed
+                once and queued whole by the reader; a command the queue
+                cannot take is counted in GetCmdErrors().
+
+Parameters:     pParser - the pty parser that completed the packet
+                ucPkt   - the unstuffed packet including DLE and DLE ETX
+                nPktLen - packet length
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipMux::OnPacket (CTsipParser *pParser,
+                         unsigned char ucPkt[], int nPktLen)
+{
+    U8  ucFramed[2 * MAX_TSIP_PKT_LEN + 4];
+    int nFramed, i;
+
+    if (nPktLen < 4)
+    {
+        return;
+    }
+
+    for (i = 0; i < m_nNumPtys; i++)
+    {
+        if (m_tPtys[i].pParser == pParser)
+        {
+            nFramed = CTsipParser::FramePkt(ucPkt[1], &ucPkt[2], nPktLen - 4,
+                                            ucFramed);
+            if (m_pReader->Send(m_nPort, ucFramed, nFramed))
+            {
+                m_tPtys[i].ulCmds++;
+            }
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnChunk
+
+Description:    Frames a chunk read from the port and hands every packet it
+                completes to Forward(), as received. Bytes outside packets
+                are not passed on. Packets the ptys took only part of are
+                finished first.
+
+Parameters:     nPort  - the port the chunk was read from
+                ucData - the bytes as read
+                nLen   - number of bytes
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipMux::OnChunk (int nPort, const unsigned char ucData[], int nLen)
+{
+    int i, j;
+
+    for (j = 0; j < m_nNumPtys; j++)
+    {
+        Finish(&m_tPtys[j]);
+    }
+
+    for (i = 0; i < nLen; i++)
+    {
+        if (TsipFrameByte(ucData[i], m_nFrameState, m_nFrameLen,
+                          m_ucFrame) == FRAME_END)
+        {
+            m_ucRaw[m_nRawLen++] = ucData[i];
+            for (j = 0; j < m_nNumPtys; j++)
+            {
+                Forward(&m_tPtys[j], m_ucRaw, m_nRawLen);
+            }
+            m_nFrameLen = 0;
+            m_nRawLen   = 0;
+        }
+        else if (m_nFrameState == MSG_IN_COMPLETE ||
+                 m_nRawLen >= MUX_RAW_LEN - 1)
+        {
+            // Noise between packets, or a packet too long to be one.
+            m_nFrameState = MSG_IN_COMPLETE;
+            m_nRawLen     = 0;
+        }
+        else
+        {
+            m_ucRaw[m_nRawLen++] = ucData[i];
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Forward
+
+Description:    Writes one packet to a pty. The pty only ever holds whole
+                packets: if it took part of an earlier packet, the rest of
+                that goes first and this packet is dropped unless all of
+                it went. A pty that has held unread data for MUX_IDLE_MS
+                has no tool attached; from then on it is flushed before
+                every packet until a tool empties it.
+
+Parameters:     ptPty - the pty
+                ucRaw - the packet as received, DLE to DLE ETX
+                nRaw  - its length
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipMux::Forward (MUX_PTY *ptPty, const U8 ucRaw[], int nRaw)
+{
+    long long llNow = m_pReader->GetWakeTime();
+    int       nUnread, nRet;
+
+    if (!Finish(ptPty))
+    {
+        ptPty->ulDrops++;
+        return;
+    }
+
+    if (ioctl(ptPty->fdSlave, TIOCINQ, &nUnread) == 0 && nUnread > 0)
+    {
+        if (ptPty->llUnreadNs == 0)
+        {
+            ptPty->llUnreadNs = llNow;
+        }
+        if (ptPty->bIdle ||
+            llNow - ptPty->llUnreadNs >= MUX_IDLE_MS * 1000000LL)
+        {
+            tcflush(ptPty->fdSlave, TCIFLUSH);
+            ptPty->bIdle      = true;
+            ptPty->llUnreadNs = 0;
+        }
+    }
+    else
+    {
+        ptPty->bIdle      = false;
+        ptPty->llUnreadNs = 0;
+    }
+
+    nRet = write(ptPty->fdMaster, ucRaw, nRaw);
+    if (nRet <= 0)
+    {
+        ptPty->ulDrops++;
+        return;
+    }
+    ptPty->ulBytes += nRet;
+    if (nRet < nRaw)
+    {
+        ptPty->nRestLen = nRaw - nRet;
+        memcpy(ptPty->ucRest, &ucRaw[nRet], ptPty->nRestLen);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Finish
+
+Description:    Writes what is left of a packet the pty took only part of.
+
+Parameters:     ptPty - the pty
+
+Return Value:   true if nothing is left.
+-----------------------------------------------------------------------------*/
+bool CTsipMux::Finish (MUX_PTY *ptPty)
+{
+    int nRet;
+
+    if (ptPty->nRestLen == 0)
+    {
+        return true;
+    }
+    nRet = write(ptPty->fdMaster, ptPty->ucRest, ptPty->nRestLen);
+    if (nRet > 0)
+    {
+        ptPty->nRestLen -= nRet;
+        memmove(ptPty->ucRest, &ptPty->ucRest[nRet], ptPty->nRestLen);
+        ptPty->ulBytes += nRet;
+    }
+    return ptPty->nRestLen == 0;
+}
@@ -0,0 +1,120 @@
+/*+ TsipMux.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines CTsipMux, which re-exports the TSIP stream of one
+ *    serial port on a number of pseudo-terminals so that other tools (the
+ *    vendor diagnostics, for instance) can use the receiver while this
+ *    program keeps reading it.
+ *
+ *    The mux is the port's CReaderTap: it frames the chunks read from the
+ *    port itself, before the port's parser sees them, and writes each
+ *    packet to every pty whole and as the receiver sent it, stuffing
+ *    included, so a consumer gets the receiver's own packets whatever the
+ *    parser filters or drops. Bytes written by a tool to its pty are
+ *    framed by a CTsipParser of their own, and only whole command packets
+ *    are passed to CSerialReader::Send(), which queues them for the port
+ *    together with the requests of a CTsipWaitHub, so commands from
+ *    several senders never interleave.
+ *
+ *    The pty master fds are read by the same CSerialReader as the ports,
+ *    as auxiliary ports so that they do not count in its statistics:
+ *
+ *        CTsipMux mux(&reader, nPort);
+ *        mux.AddPty();
+ *        reader.AddPort(mux.GetPty(0).fdMaster, mux.GetPty(0).pParser, true);
+ *
+ * Notes:
+ *    The mux keeps each pty's slave side open itself so that tools can
+ *    attach and detach at any time. A pty only ever carries whole packets:
+ *    a consumer that falls behind loses whole packets, and the part of a
+ *    packet the pty did not take is finished before anything newer is
+ *    written. A pty that nobody has read for MUX_IDLE_MS is taken to have
+ *    no tool attached and only keeps the latest packet, so a tool that
+ *    attaches later does not start on a stale backlog.
+ *
+-*/
+
+#ifndef TSIP_MUX_H
+#define TSIP_MUX_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipParser.h"
+#include "SerialReader.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define MAX_MUX_PTYS      8         // consumers per port
+#define MUX_NAME_LEN      64
+#define MUX_RAW_LEN       (2 * MAX_TSIP_PKT_LEN + 4) // a packet, stuffed
+#define MUX_IDLE_MS       2000      // unread this long: no tool attached
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct MUX_PTY
+{
+    int          fdMaster;              // read by the reader, written here
+    int          fdSlave;               // held open, never read here
+    CTsipParser *pParser;               // frames commands from the tool
+    char         strName[MUX_NAME_LEN]; // slave device, e.g. /dev/pts/3
+    U8           ucRest[MUX_RAW_LEN];   // end of a packet not yet taken
+    int          nRestLen;
+    long long    llUnreadNs;            // since when the pty holds unread data
+    bool         bIdle;                 // no tool: keep the latest packet only
+    U32          ulBytes;               // port bytes written to the pty
+    U32          ulDrops;               // packets lost, consumer too slow
+    U32          ulCmds;                // commands queued for the port
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CTsipMux : public CTsipListener, public CReaderTap
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CTsipMux(CSerialReader *pReader, int nPort);
+    virtual ~CTsipMux();
+
+    int  AddPty     ();
+    int  GetNumPtys () const { return m_nNumPtys; }
+    const MUX_PTY &GetPty (int nPty) const { return m_tPtys[nPty]; }
+    U32  GetCmdErrors () { return m_pReader->GetPort(m_nPort).ulSendErrors; }
+
+    virtual void OnPacket   (CTsipParser *pParser,
+                             unsigned char ucPkt[], int nPktLen);
+    virtual void OnChunk    (int nPort, const unsigned char ucData[], int nLen);
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    void Forward (MUX_PTY *ptPty, const U8 ucRaw[], int nRaw);
+    bool Finish  (MUX_PTY *ptPty);
+    void Flush   ();
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    CSerialReader *m_pReader;           // reads the port and the ptys
+    int            m_nPort;             // the port's index in m_pReader
+    MUX_PTY        m_tPtys[MAX_MUX_PTYS];
+    int            m_nNumPtys;
+
+    int            m_nFrameState;       // framer state of the port's stream
+    int            m_nFrameLen;
+    U8             m_ucFrame[MAX_TSIP_PKT_LEN];
+    U8             m_ucRaw[MUX_RAW_LEN]; // the packet as received
+    int            m_nRawLen;
+};
+
+#endif
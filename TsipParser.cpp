@@ -29,6 +29,7 @@
  |                         I N C L U D E   F I L E S
 \*---------------------------------------------------------------------------*/
 #include "TsipParser.h"
+#include "TsipFramer.h"
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
@@ -65,129 +66,56 @@ Return Value:   None
 void CTsipParser::ReceivePkt (unsigned char raw_data[],
                               int raw_pkt_len)
 {
-    unsigned char ucByte;
-    int           nPktLen, i;
-    int           nParseState = MSG_IN_COMPLETE;
-    unsigned char ucPkt[MAX_TSIP_PKT_LEN];
-    printf("len: %d\n",raw_pkt_len );
+    int           i;
+    int&          nParseState = m_nParseState;
+    int&          nPktLen     = m_nPktLen;
+    unsigned char *ucPkt      = m_ucPkt;
+
+    if (m_bPrint)
+    {
+        printf("len: %d\n",raw_pkt_len );
+    }
 
     // This function runs in a permanent loop until a valid TSIP packet has
     // been received on the specified serial port.
     for(i = 0; i < raw_pkt_len; i++)
     {
-//printf("in for loop i=%d\n", i);
-        // The TSIP packet is received in a local state machine.
-        ucByte = raw_data[i];
-        switch (nParseState) 
+        // The TSIP packet is received in the shared framing state machine
+        // (TsipFrameByte in TsipFramer.h).
+        switch (TsipFrameByte(raw_data[i], nParseState, nPktLen, ucPkt))
         {
-            case MSG_IN_COMPLETE:               
-                // This is the initial state in which we look for the start
-                // of the TSIP packet. We can also end up in this state if
-                // we received too many data bytes from the serial port but
-                // did not find a valid TSIP packet in that data stream.
-                // 
-                // While in this state, we look for a DLE character. If we
-                // are in this state and the DLE is received, we initialize
-                // the packet buffer and transition to the next state.
-//printf("MSG_IN_COMPLETE i=%d\n", i);
-                if (ucByte == DLE) 
-                {
-                    nParseState      = TSIP_DLE;
-                    nPktLen          = 0;
-                    ucPkt[nPktLen++] = ucByte;
-                }
-                break;
- 
-            case TSIP_DLE:
-                // The parser transitions to this state if a previosly
-                // received character was DLE. Receipt of this character
-                // indicates that we may be in one of three situations:
-                //
-                //     Case 1: DLE ETX  = end of a TSIP packet
-                //     Case 2: DLE <id> = start of a TSIP packet <id>
-                //     Case 3: DLE DLE  = a DLE byte inside the packet
-                //                        (stuffed DLE byte which is a part
-                //                        of the TSIP data)
-                // 
-                // To distinguish amongst these, we look at the next
-                // character (currently in read into ucByte). 
-                // 
-                // If the next character is ETX (Case 1), it's the end the 
-                // TSIP packet. At this point, we either have a complete TSIP
-                // packet in ucPkt or an empty packet. If we have a complete
-                // packet, return it to the caller. Otherwise, go back
-                // to the intial state and look for a valid packet again.
-                //
-                // If the next character is anything other than ETX, we
-                // add the character to the packet buffer and transition to
-                // next state to distinguish between Cases 2 and 3.
-//printf("TSIP_DLE i=%d\n", i);
-                if (ucByte == ETX) 
+            case FRAME_END:
+                if (m_bPrint)
                 {
-                    if (nPktLen > 1)
-                    {
-                        ucPkt[nPktLen++] = DLE;
-                        ucPkt[nPktLen++] = ETX;
-
-                        printf(" a complete packet, len:%d\n", nPktLen);
-                        ParsePkt(ucPkt, nPktLen);
-                        nPktLen = 0;
-                        memset(ucPkt, 0, sizeof(ucPkt));
-                        
-                        continue;
-                    }
-                    else
-                    {
-                        nParseState = MSG_IN_COMPLETE;
-                    }
+                    printf(" a complete packet, len:%d\n", nPktLen);
                 }
-                else  
-                {
-                    nParseState = TSIP_IN_PARTIAL;
-                    ucPkt[nPktLen++] = ucByte;
-                }
-                break;
+                m_ulPktCount++;
+                ParsePkt(ucPkt, nPktLen);
+                nPktLen = 0;
+                memset(ucPkt, 0, MAX_TSIP_PKT_LEN);
+                continue;
 
-            case TSIP_IN_PARTIAL:
-//printf("TSIP_IN_PARTIAL i=%d\n", i);
-                // The parser is in this state if a previous character was
-                // a part of the TSIP data. As noted above, a DLE character
-                // can be a part of the TSIP data in which case another DLE
-                // character is present in the data stream. So, here we look 
-                // at the next character in the stream (currently loaded in 
-                // ucByte). If it is a DLE character, we just encountered
-                // a stuffed DLE byte. In that case, we ignore this byte
-                // and go back to the TSIP_DLE state. That way, we will log
-                // only one DLE byte which was a part of the TSIP data.
-                //
-                // All other non-DLE characters are placed in the TSIP packet
-                // buffere.
-                if (ucByte == DLE) 
-                {
-                    nParseState = TSIP_DLE;
-                }
-                else 
-                {
-                    ucPkt[nPktLen++] = ucByte;
-                }
-                break;
+            case FRAME_SKIP:
+                m_ulFilteredBytes++;
+                continue;
 
             default:
-                // We should never be in this state. This is just for a good
-                // programming style.
-                nParseState = MSG_IN_COMPLETE;
                 break;
         }
 
-        // We get to this point after reading each byte from the serial port.
-        // Because it is not the end of the valid TSIP packet yet, we check for 
-        // the buffer overflow. If it overflows we assume something went wrong 
-        // with the end of message character(s) since no input message should
-        // be bigger than MAX_TSIP_PKT_LEN. We ignore this message and wait till 
-        // the next message starts.                                    
-        if (nPktLen >= MAX_TSIP_PKT_LEN) 
+        if (nPktLen == 1)
+        {
+            m_llPktNs = m_llChunkNs;
+        }
+
+        // The ID is byte 1 and the 0x8F sub-packet ID byte 2; decide as
+        // soon as they are in and skip the rest of an unwanted packet.
+        if (m_bFilter && (nPktLen == 2 || nPktLen == 3) &&
+            nParseState == TSIP_IN_PARTIAL && !Wanted(ucPkt, nPktLen))
         {
-            nParseState = MSG_IN_COMPLETE;
+            m_ulFilteredPkts++;
+            m_ulFilteredBytes += nPktLen;
+            nParseState = TSIP_SKIP;
             nPktLen = 0;
         }
     }
@@ -223,6 +151,18 @@ void CTsipParser::ParsePkt (unsigned char ucPkt[], int nPktLen)
     // only the size of data (which excludes the first DLE, packet
     // ID byte, and trailing DLE and ETX.
 
+    for (int i = 0; i < m_nNumListeners; i++)
+    {
+        m_pListeners[i]->OnPacket(this, ucPkt, nPktLen);
+    }
+
+    // Nothing below has side effects other than printing, so a silent
+    // parser (e.g. one used only for counting) stops here.
+    if (!m_bPrint)
+    {
+        return;
+    }
+
     switch (ucPkt[1])
     {
         /*case 0x41: Parse0x41 (&ucPkt[2], nPktLen-4); break;
@@ -249,6 +189,193 @@ void CTsipParser::ParsePkt (unsigned char ucPkt[], int nPktLen)
 
 
 
+/*-----------------------------------------------------------------------------
+Function:       Replay
+
+Description:    Hands the listeners a packet received in an earlier run,
+                e.g. one restored from a checkpoint, so that they have the
+                receiver's state before it sends again. While they are
+                called IsReplay() is true and GetArrivalTime() returns the
+                original arrival time; a listener that must only see live
+                packets checks IsReplay(). The packet is neither counted
+                nor printed, and the filter applies as to a received one.
+
+Parameters:     ucPkt       - the unstuffed packet including DLE and DLE ETX
+                nPktLen     - packet length
+                llArrivalNs - when it was received (ns, CLOCK_REALTIME)
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipParser::Replay (unsigned char ucPkt[], int nPktLen,
+                          long long llArrivalNs)
+{
+    long long llChunkNs = m_llChunkNs;
+    long long llPktNs   = m_llPktNs;
+
+    if (nPktLen < 4 || (m_bFilter && !Wanted(ucPkt, nPktLen)))
+    {
+        return;
+    }
+
+    m_bReplay   = true;
+    m_llPktNs   = llArrivalNs;
+    m_llChunkNs = 0;
+    for (int i = 0; i < m_nNumListeners; i++)
+    {
+        m_pListeners[i]->OnPacket(this, ucPkt, nPktLen);
+    }
+    m_bReplay   = false;
+    m_llPktNs   = llPktNs;
+    m_llChunkNs = llChunkNs;
+}
+
+
+
+/*-----------------------------------------------------------------------------
+Function:       AddListener
+
+Description:    Attaches an object that is told about every complete packet
+                received by this parser.
+
+Parameters:     pListener - the listener; it must outlive the parser or be
+                            removed first
+
+Return Value:   false if MAX_TSIP_LISTENERS listeners are already attached
+-----------------------------------------------------------------------------*/
+bool CTsipParser::AddListener (CTsipListener *pListener)
+{
+    if (m_nNumListeners >= MAX_TSIP_LISTENERS)
+    {
+        return false;
+    }
+    m_pListeners[m_nNumListeners++] = pListener;
+    return true;
+}
+
+void CTsipParser::RemoveListener (CTsipListener *pListener)
+{
+    int i;
+
+    for (i = 0; i < m_nNumListeners; i++)
+    {
+        if (m_pListeners[i] == pListener)
+        {
+            m_pListeners[i] = m_pListeners[--m_nNumListeners];
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       AcceptAll, RejectAll, Accept, Reject
+
+Description:    Set up the packet filter. AcceptAll() turns it off, which
+                is the default. To receive only some packets, call
+                RejectAll() and then Accept() for each of them:
+
+                    parser.RejectAll();
+                    parser.Accept(0x8F, 0xAB);
+                    parser.Accept(0x8F, 0xAC);
+
+Parameters:     ucId   - the packet ID
+                nSubId - the 0x8F sub-packet ID, or NO_SUB_ID for all of
+                         them; ignored for other packet IDs
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTsipParser::AcceptAll ()
+{
+    m_bFilter = false;
+    memset(m_ucIdMask, 0xFF, sizeof(m_ucIdMask));
+    memset(m_ucSubMask, 0xFF, sizeof(m_ucSubMask));
+}
+
+void CTsipParser::RejectAll ()
+{
+    m_bFilter = true;
+    memset(m_ucIdMask, 0, sizeof(m_ucIdMask));
+    memset(m_ucSubMask, 0, sizeof(m_ucSubMask));
+}
+
+void CTsipParser::Accept (U8 ucId, int nSubId)
+{
+    m_ucIdMask[ucId >> 3] |= 1 << (ucId & 7);
+    if (ucId == 0x8F && nSubId == NO_SUB_ID)
+    {
+        memset(m_ucSubMask, 0xFF, sizeof(m_ucSubMask));
+    }
+    else if (ucId == 0x8F)
+    {
+        m_ucSubMask[(nSubId & 0xFF) >> 3] |= 1 << (nSubId & 7);
+    }
+}
+
+void CTsipParser::Reject (U8 ucId, int nSubId)
+{
+    m_bFilter = true;
+    if (ucId == 0x8F && nSubId != NO_SUB_ID)
+    {
+        m_ucSubMask[(nSubId & 0xFF) >> 3] &= ~(1 << (nSubId & 7));
+    }
+    else
+    {
+        m_ucIdMask[ucId >> 3] &= ~(1 << (ucId & 7));
+    }
+}
+
+// Checks a packet against the filter; called by the framer with the ID
+// (nPktLen 2) and again with the sub-packet ID (nPktLen 3).
+bool CTsipParser::Wanted (const unsigned char ucPkt[], int nPktLen)
+{
+    U8 ucId = ucPkt[1];
+
+    if (!(m_ucIdMask[ucId >> 3] & (1 << (ucId & 7))))
+    {
+        return false;
+    }
+    if (nPktLen >= 3 && ucId == 0x8F)
+    {
+        return (m_ucSubMask[ucPkt[2] >> 3] & (1 << (ucPkt[2] & 7))) != 0;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       FramePkt
+
+Description:    Builds a TSIP packet ready to be written to the serial port:
+                DLE, the packet ID, the data with every DLE byte stuffed
+                (doubled), and the trailing DLE ETX.
+
+Parameters:     ucId   - the packet ID
+                ucData - the packet data
+                nLen   - number of bytes in ucData
+                ucOut  - receives the framed packet; it must hold at least
+                         2*nLen+4 bytes
+
+Return Value:   The length of the framed packet.
+-----------------------------------------------------------------------------*/
+int CTsipParser::FramePkt (U8 ucId, const U8 ucData[], int nLen, U8 ucOut[])
+{
+    int i, nOut = 0;
+
+    ucOut[nOut++] = DLE;
+    ucOut[nOut++] = ucId;
+
+    for (i = 0; i < nLen; i++)
+    {
+        ucOut[nOut++] = ucData[i];
+        if (ucData[i] == DLE)
+        {
+            ucOut[nOut++] = DLE;
+        }
+    }
+
+    ucOut[nOut++] = DLE;
+    ucOut[nOut++] = ETX;
+    return nOut;
+}
+
 /*-----------------------------------------------------------------------------
 Function:       Parse0x8F
 
@@ -286,81 +413,33 @@ Return Value:   none
 -----------------------------------------------------------------------------*/
 void CTsipParser::Parse0x8F20 (unsigned char ucData[], int nLen)
 {
-    DBL  dblLat, dblLon, dblAlt, fltTimeOfFix, dblLonDeg, dblLatDeg;
-    DBL  dblEnuVel[3], dblVelScale;
-    U32  ulTemp;
-    S32  lTemp;
-    S16  sWeekNum, ucSvIODE[32];
-    U8   ucSubpacketID, ucInfo, ucNumSVs, ucSvPrn[32], i, ucPrn, ucMaxSVs;
-    S8   cDatumIdx;
+    TSIP_8F20 tFix;
+    DBL  dblLonDeg, dblLatDeg;
+    U8   i;
     char strDatum[20];
 
-    // Check the length of the data string
-    if (nLen == 56)
-    {
-        ucMaxSVs = 8;
-    }
-    else if (nLen == 64)
-    {
-        ucMaxSVs = 12;
-    }
-    else
+    if (!CReport0x8F20::Decode (ucData, nLen, &tFix))
     {
         return;
     }
 
-    // Extract values from the data string
-    ucSubpacketID = ucData[0];
-    dblVelScale   = (ucData[24] & 1) ? 0.020 : 0.005;
-    dblEnuVel[0]  = GetShort (&ucData[2]) * dblVelScale;
-    dblEnuVel[1]  = GetShort (&ucData[4]) * dblVelScale;
-    dblEnuVel[2]  = GetShort (&ucData[6]) * dblVelScale;
-    fltTimeOfFix  = GetULong (&ucData[8]) * 0.001;
-
-    lTemp  = GetLong (&ucData[12]);
-    dblLat = lTemp*(GPS_PI/MAX_LONG);
-
-    ulTemp = GetULong (&ucData[16]);
-    dblLon = ulTemp*(GPS_PI/MAX_LONG);
-    if (dblLon > GPS_PI)
-    {
-        dblLon -= 2.0*GPS_PI;
-    }
-
-    dblAlt = GetLong (&ucData[20])*.001;
-
-    /* 25 blank; 29 = UTC */
-    cDatumIdx = ucData[26];
-    cDatumIdx--;
-
-    ucInfo   = ucData[27];
-    ucNumSVs = ucData[28];
-    sWeekNum = GetShort (&ucData[30]);
-
-    for (i=0; i<ucMaxSVs; i++) 
-    {
-        ucPrn       = ucData[32+2*i];
-        ucSvPrn[i]  = (U8)(ucPrn & 0x3F);
-        ucSvIODE[i] = (U16)(ucData[33+2*i] + 4*((S16)ucPrn-(S16)ucSvPrn[i]));
-    }
-
     // Format the output string
     printf ("Fix at: %04d:%3s:%02d:%02d:%06.3f GPS (=UTC+%2ds)  FixType: %s%s%s",
-                      sWeekNum, gstrDayName[(S16)(fltTimeOfFix/86400.0)],
-                      (S16)fmod(fltTimeOfFix/3600., 24.), 
-                      (S16)fmod(fltTimeOfFix/60., 60.),
-                      fmod(fltTimeOfFix, 60.), 
-                      (char)ucData[29],
-                      ((ucInfo & INFO_DGPS) ? "Diff" : ""),
-                      ((ucInfo & INFO_2D) ? "2D" : "3D"),
-                      ((ucInfo & INFO_FILTERED) ? "-Filtrd" : ""));
+                      tFix.sWeekNum, gstrDayName[(S16)(tFix.dblTimeOfFix/86400.0)],
+                      (S16)fmod(tFix.dblTimeOfFix/3600., 24.), 
+                      (S16)fmod(tFix.dblTimeOfFix/60., 60.),
+                      fmod(tFix.dblTimeOfFix, 60.), 
+                      (char)tFix.cUtcOffset,
+                      ((tFix.ucInfo & INFO_DGPS) ? "Diff" : ""),
+                      ((tFix.ucInfo & INFO_2D) ? "2D" : "3D"),
+                      ((tFix.ucInfo & INFO_FILTERED) ? "-Filtrd" : ""));
     
 
-    if (cDatumIdx > 0)
+    if (tFix.cDatumIdx > 0)
     {
-        sprintf(strDatum, "Datum%3d", cDatumIdx);
+        sprintf(strDatum, "Datum%3d", tFix.cDatumIdx);
     }
-    else if (cDatumIdx)
+    else if (tFix.cDatumIdx)
     {
         sprintf(strDatum, "Unknown ");
     }
@@ -370,34 +449,34 @@ void CTsipParser::Parse0x8F20 (unsigned char ucData[], int nLen)
     }
 
     /* convert from radians to degrees */
-    dblLatDeg = R2D * fabs(dblLat);
-    dblLonDeg = R2D * fabs(dblLon);
+    dblLatDeg = R2D * fabs(tFix.dblLat);
+    dblLonDeg = R2D * fabs(tFix.dblLon);
 
     printf ("\r\n   Pos: %4d:%09.6f %c %5d:%09.6f %c %10.2f m HAE (%s)",
-                      (S16)dblLatDeg, fmod(dblLatDeg, 1.)*60.0, (dblLat<0.0)?'S':'N',
-                      (S16)dblLonDeg, fmod(dblLonDeg, 1.)*60.0, (dblLon<0.0)?'W':'E',
-                      dblAlt, strDatum);
+                      (S16)dblLatDeg, fmod(dblLatDeg, 1.)*60.0, (tFix.dblLat<0.0)?'S':'N',
+                      (S16)dblLonDeg, fmod(dblLonDeg, 1.)*60.0, (tFix.dblLon<0.0)?'W':'E',
+                      tFix.dblAlt, strDatum);
     
 
     printf ("\r\n   Vel:    %9.3f E       %9.3f N      %9.3f U   (m/sec)",
-                      dblEnuVel[0], dblEnuVel[1], dblEnuVel[2]);
+                      tFix.dblEnuVel[0], tFix.dblEnuVel[1], tFix.dblEnuVel[2]);
     
 
     printf ("\r\n   SVs: ");
     
 
-    for (i=0; i<ucNumSVs; i++)
+    for (i=0; i<tFix.ucNumSVs; i++)
     {
-        printf (" %02d", ucSvPrn[i]);
+        printf (" %02d", tFix.ucSvPrn[i]);
         
     }
 
     printf ("     (IODEs:");
     
 
-    for (i=0; i<ucNumSVs; i++)
+    for (i=0; i<tFix.ucNumSVs; i++)
     {
-        printf (" %02X", ucSvIODE[i] & 0xFF);
+        printf (" %02X", tFix.sSvIODE[i] & 0xFF);
         
     }
 
@@ -419,44 +498,29 @@ Return Value:   none
 -----------------------------------------------------------------------------*/
 void CTsipParser::Parse0x8FAB (unsigned char ucData[], int nLen)
 {
-    U32 ulTimeOfWeek;
-    U16 usWeekNumber, usYear;
-    S16 sUtcOffset;
-    U8  ucTimingFlag, ucSecond, ucMinute, ucHour, ucDay, ucMonth;    
+    TSIP_8FAB tTime;
 
-    // Check the length of the data string
-    if (nLen != 17) 
+    if (!CReport0x8FAB::Decode (ucData, nLen, &tTime))
     {
         return;
     }
 
-    // Extract values from the data string
-    ulTimeOfWeek = GetULong (&ucData[1]);
-    usWeekNumber = GetUShort (&ucData[5]);
-    sUtcOffset   = GetShort (&ucData[7]);
-    ucTimingFlag = ucData[9];
-    ucSecond     = ucData[10];
-    ucMinute     = ucData[11];
-    ucHour       = ucData[12];
-    ucDay        = ucData[13];
-    ucMonth      = ucData[14];
-    usYear       = GetUShort (&ucData[15]);
-
     // Format the output string
-    printf ("8FAB: TOW: %06d  WN: %04d", ulTimeOfWeek, usWeekNumber);
+    printf ("8FAB: TOW: %06d  WN: %04d", tTime.ulTimeOfWeek, tTime.usWeekNumber);
     
 
     printf ("\r\n      %04d/%02d/%02d  %02d:%02d:%02d",
-                      usYear, ucMonth, ucDay, ucHour, ucMinute, ucSecond);
+                      tTime.usYear, tTime.ucMonth, tTime.ucDay,
+                      tTime.ucHour, tTime.ucMinute, tTime.ucSecond);
     
 
     printf ("\r\n      UTC Offset: %d s   Timing flag: 000%d%d%d%d%d",
-                      sUtcOffset,
-                      ((ucTimingFlag>>4) & 1),
-                      ((ucTimingFlag>>3) & 1),
-                      ((ucTimingFlag>>2) & 1),
-                      ((ucTimingFlag>>1) & 1),
-                      ((ucTimingFlag   ) & 1));
+                      tTime.sUtcOffset,
+                      ((tTime.ucTimingFlag>>4) & 1),
+                      ((tTime.ucTimingFlag>>3) & 1),
+                      ((tTime.ucTimingFlag>>2) & 1),
+                      ((tTime.ucTimingFlag>>1) & 1),
+                      ((tTime.ucTimingFlag   ) & 1));
     
 }
 
@@ -474,40 +538,14 @@ Return Value:   none
 -----------------------------------------------------------------------------*/
 void CTsipParser::Parse0x8FAC (unsigned char ucData[], int nLen)
 {
-    U8  ucReceiverMode, ucDiscipliningMode, ucSelfSurveyProgress;
-    U8  ucGPSDecodingStatus, ucDiscipliningActivity,ucSpareStatus1;
-    U8  ucSpareStatus2;
-    U16 usCriticalAlarms, usMinorAlarms;
-    FLT fltPPSQuality, fltTenMHzQuality, fltDACVoltage, fltTemperature;
-    U32 ulHoldoverDuration, ulDACValue;
-    DBL dblLatitude, dblLongitude, dblAltitude, dblLatDeg, dblLonDeg;
-
-    // Check the length of the data string
-    if (nLen != 68) 
+    TSIP_8FAC tStat;
+    DBL       dblLatDeg, dblLonDeg;
+
+    if (!CReport0x8FAC::Decode (ucData, nLen, &tStat))
     {
         return;
     }
 
-    // Extract values from the data string
-    ucReceiverMode         = ucData[1];
-    ucDiscipliningMode     = ucData[2];
-    ucSelfSurveyProgress   = ucData[3];
-    ulHoldoverDuration     = GetULong(&ucData[4]);
-    usCriticalAlarms       = GetUShort(&ucData[8]);
-    usMinorAlarms          = GetUShort(&ucData[10]);
-    ucGPSDecodingStatus    = ucData[12];
-    ucDiscipliningActivity = ucData[13];
-    ucSpareStatus1         = ucData[14];
-    ucSpareStatus2         = ucData[15];
-    fltPPSQuality          = GetSingle(&ucData[16]);
-    fltTenMHzQuality       = GetSingle(&ucData[20]);
-    ulDACValue             = GetULong(&ucData[24]);
-    fltDACVoltage          = GetSingle(&ucData[28]);
-    fltTemperature         = GetSingle(&ucData[32]);
-    dblLatitude            = GetDouble(&ucData[36]);
-    dblLongitude           = GetDouble(&ucData[44]);
-    dblAltitude            = GetDouble(&ucData[52]);
-
     // These text descriptions are used for formatting below.
     const char *strOprtngDim[8] = 
     {
@@ -523,185 +561,55 @@ void CTsipParser::Parse0x8FAC (unsigned char ucData[], int nLen)
 
     // Format the output string
     printf ("8FAC: RecvMode: %s   DiscMode: %d   SelfSurv: %d   Holdover: %d s",
-                      strOprtngDim[ucReceiverMode%7], ucDiscipliningMode, 
-                      ucSelfSurveyProgress, ulHoldoverDuration);
+                      strOprtngDim[tStat.ucReceiverMode%7], tStat.ucDiscipliningMode, 
+                      tStat.ucSelfSurveyProgress, tStat.ulHoldoverDuration);
     
 
     printf ("\r\n      Crit: %d%d%d%d.%d%d%d%d   Minr: %d%d%d%d.%d%d%d%d",
-                      ((usCriticalAlarms >> 7) & 1),
-                      ((usCriticalAlarms >> 6) & 1),
-                      ((usCriticalAlarms >> 5) & 1),
-                      ((usCriticalAlarms >> 4) & 1),
-                      ((usCriticalAlarms >> 3) & 1),
-                      ((usCriticalAlarms >> 7) & 1),
-                      ((usCriticalAlarms >> 1) & 1),
-                      ((usCriticalAlarms     ) & 1),
-                      ((usMinorAlarms >> 7) & 1),
-                      ((usMinorAlarms >> 6) & 1),
-                      ((usMinorAlarms >> 5) & 1),
-                      ((usMinorAlarms >> 4) & 1),
-                      ((usMinorAlarms >> 3) & 1),
-                      ((usMinorAlarms >> 7) & 1),
-                      ((usMinorAlarms >> 1) & 1),
-                      ((usMinorAlarms     ) & 1));
+                      ((tStat.usCriticalAlarms >> 7) & 1),
+                      ((tStat.usCriticalAlarms >> 6) & 1),
+                      ((tStat.usCriticalAlarms >> 5) & 1),
+                      ((tStat.usCriticalAlarms >> 4) & 1),
+                      ((tStat.usCriticalAlarms >> 3) & 1),
+                      ((tStat.usCriticalAlarms >> 7) & 1),
+                      ((tStat.usCriticalAlarms >> 1) & 1),
+                      ((tStat.usCriticalAlarms     ) & 1),
+                      ((tStat.usMinorAlarms >> 7) & 1),
+                      ((tStat.usMinorAlarms >> 6) & 1),
+                      ((tStat.usMinorAlarms >> 5) & 1),
+                      ((tStat.usMinorAlarms >> 4) & 1),
+                      ((tStat.usMinorAlarms >> 3) & 1),
+                      ((tStat.usMinorAlarms >> 7) & 1),
+                      ((tStat.usMinorAlarms >> 1) & 1),
+                      ((tStat.usMinorAlarms     ) & 1));
     
 
     printf ("\r\n      GPS Status: %d   Discpln Act: %d   Spare Status: %d %d",
-                      ucGPSDecodingStatus, ucDiscipliningActivity, 
-                      ucSpareStatus1, ucSpareStatus2);
+                      tStat.ucGPSDecodingStatus, tStat.ucDiscipliningActivity, 
+                      tStat.ucSpareStatus1, tStat.ucSpareStatus2);
     
 
     printf ("\r\n      Qual:  PPS: %.1f ns   Freq: %.3f PPB",
-                      fltPPSQuality, fltTenMHzQuality);
+                      tStat.fltPPSQuality, tStat.fltTenMHzQuality);
     
 
     printf ("\r\n      DAC:  Value: %d   Voltage: %f   Temp: %f deg C",
-                      ulDACValue, fltDACVoltage, fltTemperature);
+                      tStat.ulDACValue, tStat.fltDACVoltage, tStat.fltTemperature);
     
 
     /* convert from radians to degrees */
-    dblLatDeg = R2D * fabs(dblLatitude);
-    dblLonDeg = R2D * fabs(dblLongitude);
+    dblLatDeg = R2D * fabs(tStat.dblLatitude);
+    dblLonDeg = R2D * fabs(tStat.dblLongitude);
 
     printf ("\r\n      Pos:  %d:%09.6f %c   %d:%09.6f %c   %.2f m ",
                       (short)dblLatDeg, fmod (dblLatDeg, 1.)*60.0,
-                      (dblLatitude<0.0)?'S':'N',
+                      (tStat.dblLatitude<0.0)?'S':'N',
                       (short)dblLonDeg, fmod (dblLonDeg, 1.)*60.0,
-                      (dblLongitude<0.0)?'W':'E',
-                      dblAltitude);    
+                      (tStat.dblLongitude<0.0)?'W':'E',
+                      tStat.dblAltitude);    
     
 }
 
-/*---------------------------------------------------------------------------*\
- |            D A T A   V A L U E   E X T R A C T   R O U T I N E S
-\*---------------------------------------------------------------------------*/
-
-/*-----------------------------------------------------------------------------
-Function:       GetShort
-
-Description:    Extracts an S16 value from the data buffer pointed to by pucBuf.
-
-Parameters:     pucBuf - a pointer to the data from which to extract the value
-
-Return Value:   Extracted value
------------------------------------------------------------------------------*/
-S16 CTsipParser::GetShort (U8 *pucBuf)
-{
-    U8 ucBuf[2];
-
-    ucBuf[0] = pucBuf[1];
-    ucBuf[1] = pucBuf[0];
-
-    return (*((S16*)ucBuf));
-}
-
-/*-----------------------------------------------------------------------------
-Function:       GetUShort
-
-Description:    Extracts a U16 value from the data buffer pointed to by pucBuf.
-
-Parameters:     pucBuf - a pointer to the data from which to extract the value
-
-Return Value:   Extracted value
------------------------------------------------------------------------------*/
-U16 CTsipParser::GetUShort (U8 *pucBuf)
-{
-    U8 ucBuf[2];
-
-    ucBuf[0] = pucBuf[1];
-    ucBuf[1] = pucBuf[0];
-
-    return (*((U16*)ucBuf));
-}
-
-/*-----------------------------------------------------------------------------
-Function:       GetLong
-
-Description:    Extracts an S32 value from the data buffer pointed to by pucBuf.
-
-Parameters:     pucBuf - a pointer to the data from which to extract the value
-
-Return Value:   Extracted value
------------------------------------------------------------------------------*/
-S32 CTsipParser::GetLong (U8 *pucBuf)
-{
-    U8 ucBuf[4];
-
-    ucBuf[0] = pucBuf[3];
-    ucBuf[1] = pucBuf[2];
-    ucBuf[2] = pucBuf[1];
-    ucBuf[3] = pucBuf[0];
-
-    return (*((S32*)ucBuf));
-}
-
-/*-----------------------------------------------------------------------------
-Function:       GetULong
-
-Description:    Extracts a U32 value from the data buffer pointed to by pucBuf.
-
-Parameters:     pucBuf - a pointer to the data from which to extract the value
-
-Return Value:   Extracted value
------------------------------------------------------------------------------*/
-U32 CTsipParser::GetULong (U8 *pucBuf)
-{
-    U8 ucBuf[4];
-
-    ucBuf[0] = pucBuf[3];
-    ucBuf[1] = pucBuf[2];
-    ucBuf[2] = pucBuf[1];
-    ucBuf[3] = pucBuf[0];
-
-    return (*((U32 *)ucBuf));
-}
-
-/*-----------------------------------------------------------------------------
-Function:       GetSingle
-
-Description:    Extracts a FLT value from the data buffer pointed to by pucBuf.
-
-Parameters:     pucBuf - a pointer to the data from which to extract the value
-
-Return Value:   Extracted value
------------------------------------------------------------------------------*/
-FLT CTsipParser::GetSingle (U8 *pucBuf)
-{
-    U8 ucBuf[4];
-
-    ucBuf[0] = pucBuf[3];
-    ucBuf[1] = pucBuf[2];
-    ucBuf[2] = pucBuf[1];
-    ucBuf[3] = pucBuf[0];
-
-    return (*((FLT *)ucBuf));
-}
-
-/*-----------------------------------------------------------------------------
-Function:       GetDouble
-
-Description:    Extracts a DBL value from the data buffer pointed to by pucBuf.
-
-Parameters:     pucBuf - a pointer to the data from which to extract the value
-
-Return Value:   Extracted value
------------------------------------------------------------------------------*/
-DBL CTsipParser::GetDouble (U8* pucBuf)
-{
-    U8 ucBuf[8];
-
-    ucBuf[0] = pucBuf[7];
-    ucBuf[1] = pucBuf[6];
-    ucBuf[2] = pucBuf[5];
-    ucBuf[3] = pucBuf[4];
-    ucBuf[4] = pucBuf[3];
-    ucBuf[5] = pucBuf[2];
-    ucBuf[6] = pucBuf[1];
-    ucBuf[7] = pucBuf[0];
-
-    return (*((DBL *)ucBuf));
-}
-
 /*---------------------------------------------------------------------------*\
  |                       H E L P E R   R O U T I N E S
 \*---------------------------------------------------------------------------*/
@@ -30,45 +30,34 @@
 
 
 /*---------------------------------------------------------------------------*\
- |                     S I M P L E   D A T A   T Y P E S
+ |                         I N C L U D E   F I L E S
 \*---------------------------------------------------------------------------*/
-typedef unsigned char   S8;              /* Signed 8-bit integer (character) */
-typedef unsigned char   U8;              /* Unsigned 8-bit integer (byte)    */
-typedef signed short    S16;             /* Signed 16-bit integer (word)     */
-typedef unsigned short  U16;             /* Unsigned 16-bit integer (word)   */
-typedef signed long     S32;             /* Signed 32-bit integer (long)     */
-typedef unsigned long   U32;             /* Unsigned 32-bit integer (long)   */
-typedef float           FLT;             /* 4-byte single precision (float)  */
-typedef double          DBL;             /* 8-byte double precision (double) */
+#include "TsipTypes.h"
+#include "TsipReports.h"
 
 
-/*---------------------------------------------------------------------------*\
- |                  C O N S T A N T S   A N D   M A C R O S
-\*---------------------------------------------------------------------------*/
-#define MSG_IN_COMPLETE  0
-#define TSIP_DLE         1
-#define TSIP_IN_PARTIAL  2
-
-#define DLE              0x10 // TSIP packet start/end header         
-#define ETX              0x03 // TSIP data packet tail                
-#define MAX_TSIP_PKT_LEN 300  // max length of a TSIP packet 
-
-#define MAX_SC_MESSAGE   13
-#define MAX_EC_MESSAGE   6
-#define MAX_AS1_MESSAGE  4
+static const char* gstrDayName[7] = 
+{
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
 
-#define GPS_PI           (3.1415926535898)
-#define R2D              (180.0/GPS_PI)
+#define MAX_TSIP_LISTENERS 8   // max listeners attached to one parser
 
-#define INFO_DGPS        0x02
-#define INFO_2D          0x04
-#define INFO_FILTERED    0x10
 
-#define MAX_LONG         (2147483648.)   /* 2**31 */
+class CTsipParser;
 
-static const char* gstrDayName[7] = 
+/*---------------------------------------------------------------------------*\
+ |                    I N T E R F A C E   D E F I N I T I O N
+\*---------------------------------------------------------------------------*/
+class CTsipListener
 {
-    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+public:
+    virtual ~CTsipListener() {};
+
+    // Called for every complete packet, before it is parsed. ucPkt holds
+    // the unstuffed packet including the leading DLE and trailing DLE ETX.
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen) = 0;
 };
 
 
@@ -81,11 +70,49 @@ class CTsipParser
 
 public: //==== P U B L I C   M E T H O D S ===================================/
 
-    CTsipParser() {};
+    CTsipParser() : m_nParseState(MSG_IN_COMPLETE), m_nPktLen(0),
+                    m_ulPktCount(0), m_bPrint(true), m_nNumListeners(0),
+                    m_ulFilteredPkts(0), m_ulFilteredBytes(0),
+                    m_llChunkNs(0), m_llPktNs(0), m_bReplay(false)
+                    { AcceptAll(); };
     ~CTsipParser() {};
 
     void    ReceivePkt (unsigned char raw_data[], int raw_pkt_len);
     void ParsePkt   (unsigned char ucPkt[], int nPktLen);
+    void Replay     (unsigned char ucPkt[], int nPktLen, long long llArrivalNs);
+
+    void SetPrint    (bool bPrint) { m_bPrint = bPrint; }
+    U32  GetPktCount () { return m_ulPktCount; }
+
+    bool AddListener    (CTsipListener *pListener);
+    void RemoveListener (CTsipListener *pListener);
+
+    // Packet filter, applied by the framer as soon as the ID (and for 0x8F
+    // the sub-packet ID) has been received. A rejected packet is skipped
+    // without being copied or unstuffed and never reaches ParsePkt() or
+    // the listeners. Sub-IDs are only filtered for 0x8F.
+    void AcceptAll ();
+    void RejectAll ();
+    void Accept    (U8 ucId, int nSubId = NO_SUB_ID);
+    void Reject    (U8 ucId, int nSubId = NO_SUB_ID);
+
+    U32  GetFilteredPkts  () { return m_ulFilteredPkts; }
+    U32  GetFilteredBytes () { return m_ulFilteredBytes; }
+
+    // Arrival time of the bytes passed to the next ReceivePkt() call, set
+    // by the reader (ns, CLOCK_REALTIME). GetArrivalTime() is the arrival
+    // time of the chunk that held the first byte of the packet being
+    // parsed, GetChunkTime() that of the chunk that completed it.
+    void      SetArrivalTime (long long llNs) { m_llChunkNs = llNs; }
+    long long GetArrivalTime () { return m_llPktNs; }
+    long long GetChunkTime   () { return m_llChunkNs; }
+
+    // True while Replay() hands the listeners a packet received in an
+    // earlier run; GetArrivalTime() is then its original arrival time and
+    // GetChunkTime() is 0.
+    bool IsReplay () { return m_bReplay; }
+
+    static int FramePkt (U8 ucId, const U8 ucData[], int nLen, U8 ucOut[]);
 
 
 private: //==== P R I V A T E   M E T H O D S ================================/
@@ -99,20 +126,37 @@ private: //==== P R I V A T E   M E T H O D S ================================/
     void Parse0x4ALong  (unsigned char ucData[], int nLen);
     void Parse0x4AShort (unsigned char ucData[], int nLen);
 
-    S16  GetShort    (U8* pucBuf);
-    U16  GetUShort   (U8* pucBuf);
-    S32  GetLong     (U8* pucBuf);
-    U32  GetULong    (U8* pucBuf);
-    FLT  GetSingle   (U8* pucBuf);
-    DBL  GetDouble   (U8* pucBuf);
-
     void ShowTime (FLT fltTimeOfWeek);
 
+    bool Wanted   (const unsigned char ucPkt[], int nPktLen);
+
 
 private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
 
     //CStdString m_str, m_strTemp;
 
+    // The framer state is kept between calls to ReceivePkt so that a TSIP
+    // packet split across two serial reads is still assembled correctly.
+    int           m_nParseState;
+    int           m_nPktLen;
+    unsigned char m_ucPkt[MAX_TSIP_PKT_LEN];
+
+    U32           m_ulPktCount;     // number of complete packets framed
+    bool          m_bPrint;         // print the decoded packets to stdout
+
+    CTsipListener *m_pListeners[MAX_TSIP_LISTENERS];
+    int            m_nNumListeners;
+
+    bool          m_bFilter;        // false: accept every packet
+    U8            m_ucIdMask[32];   // bit per accepted packet ID
+    U8            m_ucSubMask[32];  // bit per accepted 0x8F sub-packet ID
+    U32           m_ulFilteredPkts;
+    U32           m_ulFilteredBytes;
+
+    long long     m_llChunkNs;      // arrival time of the current chunk
+    long long     m_llPktNs;        // arrival time of the packet's DLE
+    bool          m_bReplay;        // the listeners are being replayed to
+
 };
 
 #endif
@@ -0,0 +1,192 @@
+/*+ TsipParserT.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the CTsipParserT class template, a TSIP parser that
+ *    is specialised at compile time for a fixed set of reports.
+ *
+ *    The template is instantiated with a list of handler types. Each
+ *    handler derives from one of the report classes in TsipReports.h
+ *    (which supply ID, SUB_ID, Data and Decode) and adds
+ *
+ *        void OnReport (const Data &tData);
+ *
+ *    Only the decoders of the listed reports are compiled in, dispatch is
+ *    resolved at compile time, and the framer drops every other packet as
+ *    soon as its ID (or 0x8F sub-packet ID) byte arrives, without copying
+ *    or unstuffing the rest of it. The framing itself is the state machine
+ *    in TsipFramer.h that CTsipParser uses as well.
+ *
+ * Notes:
+ *    Example, for a deployment that only needs the timing packets:
+ *
+ *        struct CTimeSink : CReport0x8FAB
+ *            { void OnReport (const TSIP_8FAB &tTime); };
+ *        struct CStatSink : CReport0x8FAC
+ *            { void OnReport (const TSIP_8FAC &tStat); };
+ *
+ *        CTsipParserT<CTimeSink, CStatSink> parser;
+ *        parser.ReceivePkt (buf, len);
+ *
+-*/
+
+#ifndef TSIP_PARSER_T_H
+#define TSIP_PARSER_T_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include <tuple>
+#include "TsipTypes.h"
+#include "TsipFramer.h"
+#include "TsipReports.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N
+\*---------------------------------------------------------------------------*/
+template <class... Handlers>
+class CTsipParserT
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CTsipParserT() : m_nParseState(MSG_IN_COMPLETE), m_nPktLen(0),
+                     m_ulPktCount(0), m_ulSkipCount(0) {};
+    explicit CTsipParserT(const Handlers&... handlers)
+                   : m_tHandlers(handlers...),
+                     m_nParseState(MSG_IN_COMPLETE), m_nPktLen(0),
+                     m_ulPktCount(0), m_ulSkipCount(0) {};
+
+    void ReceivePkt (const unsigned char raw_data[], int raw_pkt_len);
+
+    template <class H> H& GetHandler () { return std::get<H>(m_tHandlers); }
+
+    U32  GetPktCount  () { return m_ulPktCount; }
+    U32  GetSkipCount () { return m_ulSkipCount; }
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    // true if any handler takes packet ID ucId
+    static bool WantId (U8 ucId)
+    {
+        return ((Handlers::ID == ucId) || ...);
+    }
+
+    // true if any handler takes packet ID ucId with sub-packet ID ucSubId
+    static bool WantSubId (U8 ucId, U8 ucSubId)
+    {
+        return ((Handlers::ID == ucId &&
+                 (Handlers::SUB_ID == NO_SUB_ID ||
+                  Handlers::SUB_ID == ucSubId)) || ...);
+    }
+
+    void ParsePkt ();
+
+    template <class H> bool ParseReport ();
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    std::tuple<Handlers...> m_tHandlers;
+
+    int           m_nParseState;
+    int           m_nPktLen;
+    unsigned char m_ucPkt[MAX_TSIP_PKT_LEN];
+
+    U32           m_ulPktCount;     // complete packets handed to a decoder
+    U32           m_ulSkipCount;    // packets dropped by ID
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                 T S I P   P R O C E S S O R   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       ReceivePkt
+
+Description:    Runs a chunk of raw serial data through the framer shared
+                with CTsipParser (TsipFrameByte). As soon as the packet ID
+                or the sub-packet ID byte is in and no handler wants the
+                packet, the rest of it is skipped up to its trailing DLE ETX.
+
+Parameters:     raw_data    - bytes read from the serial port
+                raw_pkt_len - number of bytes in raw_data
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+template <class... Handlers>
+void CTsipParserT<Handlers...>::ReceivePkt (const unsigned char raw_data[],
+                                            int raw_pkt_len)
+{
+    int i;
+
+    for (i = 0; i < raw_pkt_len; i++)
+    {
+        switch (TsipFrameByte(raw_data[i], m_nParseState, m_nPktLen, m_ucPkt))
+        {
+            case FRAME_END:
+                ParsePkt();
+                m_nPktLen = 0;
+                break;
+
+            case FRAME_DATA:
+                if ((m_nPktLen == 2 && !WantId(m_ucPkt[1])) ||
+                    (m_nPktLen == 3 && !WantSubId(m_ucPkt[1], m_ucPkt[2])))
+                {
+                    m_nParseState = TSIP_SKIP;
+                    m_nPktLen     = 0;
+                    m_ulSkipCount++;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       ParsePkt
+
+Description:    Hands a complete packet to the first handler whose report
+                matches it. The chain of comparisons is generated at compile
+                time from the handler list.
+
+Parameters:     none
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+template <class... Handlers>
+void CTsipParserT<Handlers...>::ParsePkt ()
+{
+    m_ulPktCount++;
+    (ParseReport<Handlers>() || ...);
+}
+
+template <class... Handlers>
+template <class H>
+bool CTsipParserT<Handlers...>::ParseReport ()
+{
+    typename H::Data tData;
+
+    if (m_ucPkt[1] != H::ID ||
+        (H::SUB_ID != NO_SUB_ID && m_ucPkt[2] != H::SUB_ID))
+    {
+        return false;
+    }
+
+    // Same convention as CTsipParser::ParsePkt: skip DLE and the ID, drop
+    // DLE, ID and DLE ETX from the length.
+    if (H::Decode(&m_ucPkt[2], m_nPktLen - 4, &tData))
+    {
+        std::get<H>(m_tHandlers).OnReport(tData);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,349 @@
+/*+ TsipReports.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the decoded form of the TSIP reports we handle and
+ *    one report class per packet that knows the packet's ID, sub-packet
+ *    ID and how to decode it.
+ *
+ *    The decoders are inline so that a parser built from CTsipParserT
+ *    (see TsipParserT.h) only pulls in the reports it was instantiated
+ *    with. CTsipParser uses the same decoders before printing.
+ *
+ * Notes:
+ *    ucData/nLen follow the convention of the CTsipParser::Parse0x8Fxx
+ *    routines: ucData points at the sub-packet ID byte (the first byte
+ *    after the packet ID) and nLen excludes DLE, ID and DLE ETX.
+ *
+-*/
+
+#ifndef TSIP_REPORTS_H
+#define TSIP_REPORTS_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include <string.h>
+#include "TsipTypes.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define NO_SUB_ID        (-1)   // report is not a super-packet
+#define MAX_8F20_SVS     12     // max SVs in a 0x8F-20 fix report
+
+
+/*---------------------------------------------------------------------------*\
+ |            D A T A   V A L U E   E X T R A C T   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       GetShort, GetUShort, GetLong, GetULong, GetSingle, GetDouble
+
+Description:    Extract a big-endian (TSIP byte order) value from the data
+                buffer pointed to by pucBuf.
+
+Parameters:     pucBuf - a pointer to the data from which to extract the value
+
+Return Value:   Extracted value
+-----------------------------------------------------------------------------*/
+static inline S16 GetShort (const U8 *pucBuf)
+{
+    U8  ucBuf[2];
+    S16 sValue;
+
+    ucBuf[0] = pucBuf[1];
+    ucBuf[1] = pucBuf[0];
+
+    memcpy(&sValue, ucBuf, sizeof(sValue));
+    return sValue;
+}
+
+static inline U16 GetUShort (const U8 *pucBuf)
+{
+    return (U16)GetShort(pucBuf);
+}
+
+static inline S32 GetLong (const U8 *pucBuf)
+{
+    U8  ucBuf[4];
+    S32 lValue;
+
+    ucBuf[0] = pucBuf[3];
+    ucBuf[1] = pucBuf[2];
+    ucBuf[2] = pucBuf[1];
+    ucBuf[3] = pucBuf[0];
+
+    memcpy(&lValue, ucBuf, sizeof(lValue));
+    return lValue;
+}
+
+static inline U32 GetULong (const U8 *pucBuf)
+{
+    return (U32)GetLong(pucBuf);
+}
+
+static inline FLT GetSingle (const U8 *pucBuf)
+{
+    U32 ulValue = GetULong(pucBuf);
+    FLT fltValue;
+
+    memcpy(&fltValue, &ulValue, sizeof(fltValue));
+    return fltValue;
+}
+
+static inline DBL GetDouble (const U8 *pucBuf)
+{
+    U8  ucBuf[8];
+    DBL dblValue;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        ucBuf[i] = pucBuf[7 - i];
+    }
+
+    memcpy(&dblValue, ucBuf, sizeof(dblValue));
+    return dblValue;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct TSIP_8F20                         // Last fix with extra information
+{
+    DBL dblTimeOfFix;                    // GPS time of week (s)
+    DBL dblLat, dblLon;                  // position (rad)
+    DBL dblAlt;                          // altitude (m HAE)
+    DBL dblEnuVel[3];                    // velocity east/north/up (m/s)
+    S16 sWeekNum;                        // GPS week number
+    S8  cDatumIdx;                       // datum index, minus one
+    S8  cUtcOffset;                      // GPS-UTC offset (s)
+    U8  ucInfo;                          // INFO_xxx fix flags
+    U8  ucNumSVs;                        // SVs used in the fix
+    U8  ucMaxSVs;                        // SV slots in the packet (8 or 12)
+    U8  ucSvPrn[MAX_8F20_SVS];           // PRN of each SV
+    S16 sSvIODE[MAX_8F20_SVS];           // IODE of each SV
+};
+
+struct TSIP_8FAB                         // Primary timing packet
+{
+    U32 ulTimeOfWeek;                    // GPS seconds of week
+    U16 usWeekNumber;                    // GPS week number
+    S16 sUtcOffset;                      // GPS-UTC offset (s)
+    U8  ucTimingFlag;                    // time base and validity flags
+    U8  ucSecond, ucMinute, ucHour;
+    U8  ucDay, ucMonth;
+    U16 usYear;
+};
+
+struct TSIP_8FAC                         // Supplemental timing packet
+{
+    U8  ucReceiverMode;
+    U8  ucDiscipliningMode;
+    U8  ucSelfSurveyProgress;            // percent
+    U32 ulHoldoverDuration;              // seconds
+    U16 usCriticalAlarms;
+    U16 usMinorAlarms;
+    U8  ucGPSDecodingStatus;
+    U8  ucDiscipliningActivity;
+    U8  ucSpareStatus1;
+    U8  ucSpareStatus2;
+    FLT fltPPSQuality;                   // ns
+    FLT fltTenMHzQuality;                // PPB
+    U32 ulDACValue;
+    FLT fltDACVoltage;                   // V
+    FLT fltTemperature;                  // deg C
+    DBL dblLatitude, dblLongitude;       // rad
+    DBL dblAltitude;                     // m
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CReport0x8F20
+{
+public:
+    enum { ID = 0x8F, SUB_ID = 0x20 };
+    typedef TSIP_8F20 Data;
+
+    static bool Decode (const U8 ucData[], int nLen, TSIP_8F20 *ptData);
+};
+
+class CReport0x8FAB
+{
+public:
+    enum { ID = 0x8F, SUB_ID = 0xAB };
+    typedef TSIP_8FAB Data;
+
+    static bool Decode (const U8 ucData[], int nLen, TSIP_8FAB *ptData);
+};
+
+class CReport0x8FAC
+{
+public:
+    enum { ID = 0x8F, SUB_ID = 0xAC };
+    typedef TSIP_8FAC Data;
+
+    static bool Decode (const U8 ucData[], int nLen, TSIP_8FAC *ptData);
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      R E P O R T   D E C O D E R S
+\*---------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+Function:       CReport0x8F20::Decode
+
+Description:    Extracts the data values from a 0x8F-20 fix report.
+
+Parameters:     ucData - a pointer to the start of the TSIP data values buffer
+                nLen   - number of TSIP data bytes in the data buffer ucData
+                ptData - receives the decoded values
+
+Return Value:   false if the packet has an unexpected length
+-----------------------------------------------------------------------------*/
+inline bool CReport0x8F20::Decode (const U8 ucData[], int nLen,
+                                   TSIP_8F20 *ptData)
+{
+    DBL dblVelScale;
+    U8  i, ucPrn;
+
+    // Check the length of the data string
+    if (nLen == 56)
+    {
+        ptData->ucMaxSVs = 8;
+    }
+    else if (nLen == 64)
+    {
+        ptData->ucMaxSVs = 12;
+    }
+    else
+    {
+        return false;
+    }
+
+    // Extract values from the data string
+    dblVelScale             = (ucData[24] & 1) ? 0.020 : 0.005;
+    ptData->dblEnuVel[0]    = GetShort (&ucData[2]) * dblVelScale;
+    ptData->dblEnuVel[1]    = GetShort (&ucData[4]) * dblVelScale;
+    ptData->dblEnuVel[2]    = GetShort (&ucData[6]) * dblVelScale;
+    ptData->dblTimeOfFix    = GetULong (&ucData[8]) * 0.001;
+
+    ptData->dblLat = GetLong (&ucData[12])*(GPS_PI/MAX_LONG);
+    ptData->dblLon = GetULong (&ucData[16])*(GPS_PI/MAX_LONG);
+    if (ptData->dblLon > GPS_PI)
+    {
+        ptData->dblLon -= 2.0*GPS_PI;
+    }
+
+    ptData->dblAlt = GetLong (&ucData[20])*.001;
+
+    /* 25 blank; 29 = UTC */
+    ptData->cDatumIdx  = ucData[26];
+    ptData->cDatumIdx--;
+    ptData->cUtcOffset = ucData[29];
+
+    ptData->ucInfo   = ucData[27];
+    ptData->ucNumSVs = ucData[28];
+    ptData->sWeekNum = GetShort (&ucData[30]);
+    if (ptData->ucNumSVs > ptData->ucMaxSVs)
+    {
+        ptData->ucNumSVs = ptData->ucMaxSVs;
+    }
+
+    for (i = 0; i < ptData->ucMaxSVs; i++)
+    {
+        ucPrn              = ucData[32+2*i];
+        ptData->ucSvPrn[i] = (U8)(ucPrn & 0x3F);
+        ptData->sSvIODE[i] = (U16)(ucData[33+2*i] +
+                                   4*((S16)ucPrn-(S16)ptData->ucSvPrn[i]));
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       CReport0x8FAB::Decode
+
+Description:    Extracts the data values from a 0x8F-AB primary timing
+                packet.
+
+Parameters:     ucData - a pointer to the start of the TSIP data values buffer
+                nLen   - number of TSIP data bytes in the data buffer ucData
+                ptData - receives the decoded values
+
+Return Value:   false if the packet has an unexpected length
+-----------------------------------------------------------------------------*/
+inline bool CReport0x8FAB::Decode (const U8 ucData[], int nLen,
+                                   TSIP_8FAB *ptData)
+{
+    // Check the length of the data string
+    if (nLen != 17)
+    {
+        return false;
+    }
+
+    // Extract values from the data string
+    ptData->ulTimeOfWeek = GetULong (&ucData[1]);
+    ptData->usWeekNumber = GetUShort (&ucData[5]);
+    ptData->sUtcOffset   = GetShort (&ucData[7]);
+    ptData->ucTimingFlag = ucData[9];
+    ptData->ucSecond     = ucData[10];
+    ptData->ucMinute     = ucData[11];
+    ptData->ucHour       = ucData[12];
+    ptData->ucDay        = ucData[13];
+    ptData->ucMonth      = ucData[14];
+    ptData->usYear       = GetUShort (&ucData[15]);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       CReport0x8FAC::Decode
+
+Description:    Extracts the data values from a 0x8F-AC supplemental timing
+                packet.
+
+Parameters:     ucData - a pointer to the start of the TSIP data values buffer
+                nLen   - number of TSIP data bytes in the data buffer ucData
+                ptData - receives the decoded values
+
+Return Value:   false if the packet has an unexpected length
+-----------------------------------------------------------------------------*/
+inline bool CReport0x8FAC::Decode (const U8 ucData[], int nLen,
+                                   TSIP_8FAC *ptData)
+{
+    // Check the length of the data string
+    if (nLen != 68)
+    {
+        return false;
+    }
+
+    // Extract values from the data string
+    ptData->ucReceiverMode         = ucData[1];
+    ptData->ucDiscipliningMode     = ucData[2];
+    ptData->ucSelfSurveyProgress   = ucData[3];
+    ptData->ulHoldoverDuration     = GetULong(&ucData[4]);
+    ptData->usCriticalAlarms       = GetUShort(&ucData[8]);
+    ptData->usMinorAlarms          = GetUShort(&ucData[10]);
+    ptData->ucGPSDecodingStatus    = ucData[12];
+    ptData->ucDiscipliningActivity = ucData[13];
+    ptData->ucSpareStatus1         = ucData[14];
+    ptData->ucSpareStatus2         = ucData[15];
+    ptData->fltPPSQuality          = GetSingle(&ucData[16]);
+    ptData->fltTenMHzQuality       = GetSingle(&ucData[20]);
+    ptData->ulDACValue             = GetULong(&ucData[24]);
+    ptData->fltDACVoltage          = GetSingle(&ucData[28]);
+    ptData->fltTemperature         = GetSingle(&ucData[32]);
+    ptData->dblLatitude            = GetDouble(&ucData[36]);
+    ptData->dblLongitude           = GetDouble(&ucData[44]);
+    ptData->dblAltitude            = GetDouble(&ucData[52]);
+    return true;
+}
+
+#endif
@@ -0,0 +1,492 @@
+/*+ TsipStats.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the streaming statistics classes and the
+ *    0x8F-AC timing quality rollups.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipStats.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+
+static const char* gstrStatName[NUM_STATS] =
+{
+    "PPS", "Freq", "DAC", "Temp"
+};
+
+// The sketch rounds to the middle of a bin; never report a quantile
+// outside the exact range of the samples.
+static DBL Clamp (DBL dblValue, const CMoments &tMoments)
+{
+    if (dblValue < tMoments.GetMin())
+    {
+        return tMoments.GetMin();
+    }
+    if (dblValue > tMoments.GetMax())
+    {
+        return tMoments.GetMax();
+    }
+    return dblValue;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                       M O M E N T   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+void CMoments::Reset ()
+{
+    m_ulCount = 0;
+    m_dblMin  = m_dblMax = 0.0;
+    m_dblMean = m_dblM2  = 0.0;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Add
+
+Description:    Adds a sample using Welford's update, which stays accurate
+                where the naive sum of squares would cancel out. NaN and
+                infinite samples are ignored; one of them would poison the
+                mean and variance for good.
+
+Parameters:     dblValue - the sample
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CMoments::Add (DBL dblValue)
+{
+    DBL dblDelta;
+
+    if (!isfinite(dblValue))
+    {
+        return;
+    }
+
+    if (m_ulCount == 0 || dblValue < m_dblMin)
+    {
+        m_dblMin = dblValue;
+    }
+    if (m_ulCount == 0 || dblValue > m_dblMax)
+    {
+        m_dblMax = dblValue;
+    }
+
+    m_ulCount++;
+    dblDelta   = dblValue - m_dblMean;
+    m_dblMean += dblDelta / m_ulCount;
+    m_dblM2   += dblDelta * (dblValue - m_dblMean);
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Merge
+
+Description:    Combines the samples of another CMoments into this one
+                (Chan et al. parallel update).
+
+Parameters:     tOther - the moments to add
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CMoments::Merge (const CMoments &tOther)
+{
+    DBL dblDelta;
+    U32 ulCount;
+
+    if (tOther.m_ulCount == 0)
+    {
+        return;
+    }
+    if (m_ulCount == 0)
+    {
+        *this = tOther;
+        return;
+    }
+
+    ulCount  = m_ulCount + tOther.m_ulCount;
+    dblDelta = tOther.m_dblMean - m_dblMean;
+
+    m_dblMean += dblDelta * tOther.m_ulCount / ulCount;
+    m_dblM2   += tOther.m_dblM2 +
+                 dblDelta * dblDelta * m_ulCount * tOther.m_ulCount / ulCount;
+    m_dblMin   = (tOther.m_dblMin < m_dblMin) ? tOther.m_dblMin : m_dblMin;
+    m_dblMax   = (tOther.m_dblMax > m_dblMax) ? tOther.m_dblMax : m_dblMax;
+    m_ulCount  = ulCount;
+}
+
+DBL CMoments::GetStdDev () const
+{
+    return (m_ulCount > 1) ? sqrt(m_dblM2 / (m_ulCount - 1)) : 0.0;
+}
+
+
+/*---------------------------------------------------------------------------*\
+ |                       S K E T C H   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+template <class T>
+void CQuantileSketchT<T>::Reset ()
+{
+    m_ulCount = 0;
+    m_ulZero  = 0;
+    memset(m_tPos, 0, sizeof(m_tPos));
+    memset(m_tNeg, 0, sizeof(m_tNeg));
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Bin, BinValue
+
+Description:    Bin n holds magnitudes in (MIN*GAMMA^(n-1), MIN*GAMMA^n].
+                BinValue returns the point of the bin whose relative
+                distance to both edges is SKETCH_ACCURACY. Magnitudes
+                outside the covered range go to the first or last bin;
+                they are clamped before the conversion to int, which is
+                undefined for values that do not fit.
+-----------------------------------------------------------------------------*/
+template <class T>
+int CQuantileSketchT<T>::Bin (DBL dblMagnitude)
+{
+    DBL dblBin;
+
+    if (!(dblMagnitude > SKETCH_MIN_VALUE))
+    {
+        return 0;
+    }
+
+    dblBin = ceil(log(dblMagnitude / SKETCH_MIN_VALUE) / log(SKETCH_GAMMA));
+    if (dblBin >= SKETCH_BINS - 1)
+    {
+        return SKETCH_BINS - 1;
+    }
+    return (int)dblBin;
+}
+
+template <class T>
+DBL CQuantileSketchT<T>::BinValue (int nBin)
+{
+    return SKETCH_MIN_VALUE * pow(SKETCH_GAMMA, nBin) * 2.0 /
+           (SKETCH_GAMMA + 1.0);
+}
+
+// NaN and infinite samples are ignored, as in CMoments::Add.
+template <class T>
+void CQuantileSketchT<T>::Add (DBL dblValue)
+{
+    T *ptBin;
+
+    if (!isfinite(dblValue))
+    {
+        return;
+    }
+
+    if (fabs(dblValue) < SKETCH_MIN_VALUE)
+    {
+        m_ulZero++;
+    }
+    else
+    {
+        ptBin = (dblValue > 0) ? &m_tPos[Bin(dblValue)]
+                               : &m_tNeg[Bin(-dblValue)];
+        if (*ptBin == (T)~(T)0)
+        {
+            return;                     // bin saturated, drop the sample
+        }
+        (*ptBin)++;
+    }
+    m_ulCount++;
+}
+
+template <class T>
+void CQuantileSketchT<T>::Merge (const CQuantileSketchT &tOther)
+{
+    const T tMax = (T)~(T)0;
+    int     i;
+
+    m_ulZero += tOther.m_ulZero;
+    m_ulCount = m_ulZero;
+    for (i = 0; i < SKETCH_BINS; i++)
+    {
+        m_tPos[i]  = (tOther.m_tPos[i] > tMax - m_tPos[i]) ?
+                     tMax : (T)(m_tPos[i] + tOther.m_tPos[i]);
+        m_tNeg[i]  = (tOther.m_tNeg[i] > tMax - m_tNeg[i]) ?
+                     tMax : (T)(m_tNeg[i] + tOther.m_tNeg[i]);
+        m_ulCount += m_tPos[i] + m_tNeg[i];
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Quantile
+
+Description:    Walks the bins from the most negative value upwards until
+                the requested rank is reached.
+
+Parameters:     dblQ - the quantile, 0.0 to 1.0
+
+Return Value:   The estimated value, 0.0 if the sketch is empty.
+-----------------------------------------------------------------------------*/
+template <class T>
+DBL CQuantileSketchT<T>::Quantile (DBL dblQ) const
+{
+    U32 ulRank, ulSeen = 0;
+    int i;
+
+    if (m_ulCount == 0)
+    {
+        return 0.0;
+    }
+    ulRank = (U32)(dblQ * (m_ulCount - 1));
+
+    for (i = SKETCH_BINS - 1; i >= 0; i--)
+    {
+        ulSeen += m_tNeg[i];
+        if (ulSeen > ulRank)
+        {
+            return -BinValue(i);
+        }
+    }
+
+    ulSeen += m_ulZero;
+    if (ulSeen > ulRank)
+    {
+        return 0.0;
+    }
+
+    for (i = 0; i < SKETCH_BINS; i++)
+    {
+        ulSeen += m_tPos[i];
+        if (ulSeen > ulRank)
+        {
+            return BinValue(i);
+        }
+    }
+    return BinValue(SKETCH_BINS - 1);
+}
+
+template class CQuantileSketchT<U16>;
+template class CQuantileSketchT<U32>;
+
+
+/*---------------------------------------------------------------------------*\
+ |                   T I M I N G   R O L L U P   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CTimingStats::CTimingStats(const char *strName)
+{
+    int i;
+
+    m_strName    = strName;
+    m_llMinute   = -1;
+    m_llLastData = -1;
+    m_ptPanes  = new STAT_PANE[STAT_NUM_PANES];
+    for (i = 0; i < STAT_NUM_PANES; i++)
+    {
+        m_ptPanes[i].llMinute = -1;
+    }
+}
+
+CTimingStats::~CTimingStats()
+{
+    delete [] m_ptPanes;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       AddReport
+
+Description:    Adds the quality metrics of a 0x8F-AC report to the pane of
+                the current minute, closing the minutes that are over
+                first.
+
+Parameters:     tStat - the decoded report
+                llNow - arrival time, seconds since the epoch
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTimingStats::AddReport (const TSIP_8FAC &tStat, long long llNow)
+{
+    long long  llMinute = llNow / STAT_PANE_SECS;
+    STAT_PANE *ptPane   = &m_ptPanes[llMinute % STAT_NUM_PANES];
+    DBL        dblValue[NUM_STATS];
+    int        i;
+
+    Tick(llNow);
+
+    // A minute that is already closed stays closed; if the system clock
+    // stepped back the report counts towards the open minute.
+    if (llMinute < m_llMinute)
+    {
+        llMinute = m_llMinute;
+        ptPane   = &m_ptPanes[llMinute % STAT_NUM_PANES];
+    }
+
+    if (ptPane->llMinute != llMinute)
+    {
+        ptPane->llMinute = llMinute;
+        for (i = 0; i < NUM_STATS; i++)
+        {
+            ptPane->tMoments[i].Reset();
+            ptPane->tSketch[i].Reset();
+        }
+    }
+    m_llMinute   = llMinute;
+    m_llLastData = llMinute;
+
+    dblValue[STAT_PPS_QUALITY]  = tStat.fltPPSQuality;
+    dblValue[STAT_FREQ_QUALITY] = tStat.fltTenMHzQuality;
+    dblValue[STAT_DAC_VOLTAGE]  = tStat.fltDACVoltage;
+    dblValue[STAT_TEMPERATURE]  = tStat.fltTemperature;
+
+    for (i = 0; i < NUM_STATS; i++)
+    {
+        ptPane->tMoments[i].Add(dblValue[i]);
+        ptPane->tSketch[i].Add(dblValue[i]);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Tick
+
+Description:    Closes every minute that is over, including minutes in
+                which no report arrived: they still end a sliding window
+                and may end an hour. Called for every report and from the
+                event loop, so that rollups are printed on time even when
+                the receiver goes quiet.
+
+                Once the last pane with data has left the sliding window
+                nothing is left to print, and a long gap is skipped.
+
+Parameters:     llNow - current time, seconds since the epoch
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTimingStats::Tick (long long llNow)
+{
+    long long llCurrent = llNow / STAT_PANE_SECS;
+
+    if (m_llMinute < 0)
+    {
+        return;
+    }
+
+    while (m_llMinute < llCurrent)
+    {
+        if (m_llMinute - m_llLastData >= STAT_NUM_PANES)
+        {
+            m_llMinute = llCurrent;
+            break;
+        }
+        ClosePane(m_llMinute);
+        m_llMinute++;
+    }
+}
+
+void CTimingStats::ClosePane (long long llMinute)
+{
+    Emit("1m", llMinute, llMinute);
+    Emit("1h-sliding", llMinute - STAT_NUM_PANES + 1, llMinute);
+
+    if ((llMinute + 1) % STAT_NUM_PANES == 0)
+    {
+        Emit("1h", llMinute - STAT_NUM_PANES + 1, llMinute);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Emit
+
+Description:    Merges the panes of minutes llFirst..llLast and prints one
+                rollup line per metric.
+
+Parameters:     strWindow - the window label
+                llFirst   - first minute of the window
+                llLast    - last minute of the window
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CTimingStats::Emit (const char *strWindow, long long llFirst,
+                         long long llLast)
+{
+    static CQuantileSketch tSketch;     // 3 KB, kept off the stack
+    CMoments               tMoments;
+    STAT_PANE             *ptPane;
+    struct tm              tEnd;
+    time_t                 tEndSec = (time_t)((llLast + 1) * STAT_PANE_SECS);
+    char                   strEnd[24];
+    long long              llMinute;
+    int                    i;
+
+    gmtime_r(&tEndSec, &tEnd);
+    strftime(strEnd, sizeof(strEnd), "%Y-%m-%dT%H:%M:%SZ", &tEnd);
+
+    for (i = 0; i < NUM_STATS; i++)
+    {
+        tMoments.Reset();
+        tSketch.Reset();
+        for (llMinute = llFirst; llMinute <= llLast; llMinute++)
+        {
+            ptPane = &m_ptPanes[llMinute % STAT_NUM_PANES];
+            if (ptPane->llMinute == llMinute)
+            {
+                tMoments.Merge(ptPane->tMoments[i]);
+                tSketch.Merge(ptPane->tSketch[i]);
+            }
+        }
+
+        if (tMoments.GetCount() == 0)
+        {
+            continue;
+        }
+
+        printf("%s rollup %-10s %s %-4s n: %u  min: %.4g  max: %.4g"
+               "  mean: %.4g  sd: %.4g  p50: %.4g  p95: %.4g  p99: %.4g\n",
+               m_strName, strWindow, strEnd, gstrStatName[i],
+               tMoments.GetCount(), tMoments.GetMin(), tMoments.GetMax(),
+               tMoments.GetMean(), tMoments.GetStdDev(),
+               Clamp(tSketch.Quantile(0.50), tMoments),
+               Clamp(tSketch.Quantile(0.95), tMoments),
+               Clamp(tSketch.Quantile(0.99), tMoments));
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Feeds every 0x8F-AC packet received by the parser into the
+                rollups, timestamped with the local clock. A replayed report
+                goes into the minute it was originally received in.
+-----------------------------------------------------------------------------*/
+void CTimingStats::OnPacket (CTsipParser *pParser,
+                             unsigned char ucPkt[], int nPktLen)
+{
+    TSIP_8FAC tStat;
+
+    if (nPktLen < 5 || ucPkt[1] != CReport0x8FAC::ID ||
+        ucPkt[2] != CReport0x8FAC::SUB_ID)
+    {
+        return;
+    }
+
+    if (!CReport0x8FAC::Decode(&ucPkt[2], nPktLen - 4, &tStat))
+    {
+        return;
+    }
+    if (pParser->IsReplay())
+    {
+        AddReport(tStat, pParser->GetArrivalTime() / 1000000000LL);
+    }
+    else
+    {
+        AddReport(tStat, (long long)time(NULL));
+    }
+}
@@ -0,0 +1,142 @@
+/*+ TsipStats.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines streaming statistics used to roll up the timing
+ *    quality reported in 0x8F-AC packets:
+ *
+ *    CMoments        - count, min, max, mean and variance (Welford), which
+ *                      can be merged with another CMoments.
+ *    CQuantileSketch - a fixed-size log-bucket histogram that answers
+ *                      quantile queries to within SKETCH_ACCURACY of the
+ *                      true value, and can also be merged. Its bins hold
+ *                      up to 65535 samples each, plenty for a one-minute
+ *                      pane; CQuantileSketch32 has 32-bit bins for
+ *                      measurements that run for hours.
+ *    CTimingStats    - keeps one pane of both per metric for each of the
+ *                      last STAT_NUM_PANES minutes and prints per-minute
+ *                      and per-hour tumbling rollups plus a sliding
+ *                      one-hour rollup every minute.
+ *
+ *    Memory is fixed at construction; nothing grows with the number of
+ *    samples.
+ *
+ * Notes:
+ *
+-*/
+
+#ifndef TSIP_STATS_H
+#define TSIP_STATS_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipParser.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define SKETCH_GAMMA      1.04      // bucket growth factor
+#define SKETCH_ACCURACY   0.02      // (GAMMA-1)/(GAMMA+1), relative error
+#define SKETCH_MIN_VALUE  1e-3      // smaller magnitudes count as zero
+#define SKETCH_BINS       412       // covers SKETCH_MIN_VALUE .. 1e4
+
+#define STAT_PPS_QUALITY  0         // fltPPSQuality (ns)
+#define STAT_FREQ_QUALITY 1         // fltTenMHzQuality (PPB)
+#define STAT_DAC_VOLTAGE  2         // fltDACVoltage (V)
+#define STAT_TEMPERATURE  3         // fltTemperature (deg C)
+#define NUM_STATS         4
+
+#define STAT_PANE_SECS    60        // one pane per minute
+#define STAT_NUM_PANES    60        // one hour of panes
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CMoments
+{
+public:
+    CMoments() { Reset(); };
+
+    void Reset ();
+    void Add   (DBL dblValue);
+    void Merge (const CMoments &tOther);
+
+    U32  GetCount  () const { return m_ulCount; }
+    DBL  GetMin    () const { return m_dblMin; }
+    DBL  GetMax    () const { return m_dblMax; }
+    DBL  GetMean   () const { return m_dblMean; }
+    DBL  GetStdDev () const;
+
+private:
+    U32 m_ulCount;
+    DBL m_dblMin, m_dblMax;
+    DBL m_dblMean;
+    DBL m_dblM2;                        // sum of squared deviations
+};
+
+template <class T>
+class CQuantileSketchT
+{
+public:
+    CQuantileSketchT() { Reset(); };
+
+    void Reset    ();
+    void Add      (DBL dblValue);
+    void Merge    (const CQuantileSketchT &tOther);
+    DBL  Quantile (DBL dblQ) const;
+
+private:
+    static int Bin      (DBL dblMagnitude);
+    static DBL BinValue (int nBin);
+
+    U32 m_ulCount;
+    U32 m_ulZero;                       // |value| < SKETCH_MIN_VALUE
+    T   m_tPos[SKETCH_BINS];            // positive values, by bin
+    T   m_tNeg[SKETCH_BINS];            // negative values, by bin
+};
+
+typedef CQuantileSketchT<U16> CQuantileSketch;
+typedef CQuantileSketchT<U32> CQuantileSketch32;
+
+struct STAT_PANE
+{
+    long long       llMinute;           // minute number, -1 if unused
+    CMoments        tMoments[NUM_STATS];
+    CQuantileSketch tSketch[NUM_STATS];
+};
+
+class CTimingStats : public CTsipListener
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CTimingStats(const char *strName);
+    virtual ~CTimingStats();
+
+    void AddReport (const TSIP_8FAC &tStat, long long llNow);
+    void Tick      (long long llNow);
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+
+private: //==== P R I V A T E   M E T H O D S ================================/
+
+    void ClosePane (long long llMinute);
+    void Emit      (const char *strWindow, long long llFirst, long long llLast);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    const char *m_strName;              // prefix of the rollup lines
+    STAT_PANE  *m_ptPanes;              // STAT_NUM_PANES, indexed by minute
+    long long   m_llMinute;             // first minute not closed, -1: none
+    long long   m_llLastData;           // last minute with a report
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*+ TsipSvTable.cpp
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file implements the CSvTable per-satellite tracking table.
+ *
+ * Notes:
+ *
+-*/
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipSvTable.h"
+#include <stdio.h>
+#include <string.h>
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S V   T A B L E   R O U T I N E S
+\*---------------------------------------------------------------------------*/
+
+CSvTable::CSvTable()
+{
+    Reset();
+}
+
+void CSvTable::Reset ()
+{
+    memset(m_tSv, 0, sizeof(m_tSv));
+    m_ullInUse  = 0;
+    m_ulFixes   = 0;
+    m_ulLastFix = 0;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Update
+
+Description:    Folds one fix report into the table. Only the SVs listed in
+                the fix are touched, plus a bit mask compare to find the
+                SVs that dropped out of use since the previous fix.
+
+Parameters:     tFix - the decoded 0x8F-20 report
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CSvTable::Update (const TSIP_8F20 &tFix)
+{
+    unsigned long long ullInUse = 0, ullDropped;
+    SV_STATE *ptSv;
+    U32 ulNow;
+    U8  i, ucPrn;
+
+    // Week and TOW are never both zero for a real fix, so 0 can mean
+    // "never seen" in ulFirstSeen.
+    ulNow = (U32)(U16)tFix.sWeekNum * SECS_PER_WEEK + (U32)tFix.dblTimeOfFix;
+    if (ulNow == 0)
+    {
+        ulNow = 1;
+    }
+
+    for (i = 0; i < tFix.ucNumSVs; i++)
+    {
+        ucPrn = tFix.ucSvPrn[i];
+        if (ucPrn == 0 || (ullInUse & (1ULL << ucPrn)))
+        {
+            continue;                       // empty slot or listed twice
+        }
+        ullInUse |= 1ULL << ucPrn;
+
+        ptSv = &m_tSv[ucPrn];
+        // An SV coming back after a drop-out usually has a new IODE;
+        // only a change from one fix to the next counts.
+        if (ptSv->ulFirstSeen == 0)
+        {
+            ptSv->ulFirstSeen = ulNow;
+        }
+        else if (ptSv->bInUse && ptSv->sIODE != tFix.sSvIODE[i] &&
+                 ptSv->usIodeChanges < 0xFFFF)
+        {
+            ptSv->usIodeChanges++;
+        }
+        if (!ptSv->bInUse)
+        {
+            ptSv->ulRises++;
+            ptSv->bInUse = 1;
+        }
+        ptSv->ulLastSeen = ulNow;
+        ptSv->ulFixCount++;
+        ptSv->sIODE      = tFix.sSvIODE[i];
+    }
+
+    ullDropped = m_ullInUse & ~ullInUse;
+    while (ullDropped != 0)
+    {
+        m_tSv[__builtin_ctzll(ullDropped)].bInUse = 0;
+        ullDropped &= ullDropped - 1;
+    }
+
+    m_ullInUse  = ullInUse;
+    m_ulLastFix = ulNow;
+    m_ulFixes++;
+}
+
+/*-----------------------------------------------------------------------------
+Function:       Print
+
+Description:    Prints one line per SV that has been seen.
+
+Parameters:     strName - prefix of each line, normally the port name
+
+Return Value:   none
+-----------------------------------------------------------------------------*/
+void CSvTable::Print (const char *strName) const
+{
+    const SV_STATE *ptSv;
+    int i;
+
+    printf("%s svs: fixes: %u  in use: %d\n", strName, m_ulFixes, GetNumInUse());
+    for (i = 1; i < MAX_SV_PRN; i++)
+    {
+        if ((ptSv = GetSv(i)) == NULL)
+        {
+            continue;
+        }
+        printf("%s sv %02d %s first: %04u:%06u last: %04u:%06u"
+               "  fixes: %u  rises: %u  iode: %02X changes: %u\n",
+               strName, i, ptSv->bInUse ? "used" : "    ",
+               ptSv->ulFirstSeen / SECS_PER_WEEK,
+               ptSv->ulFirstSeen % SECS_PER_WEEK,
+               ptSv->ulLastSeen / SECS_PER_WEEK,
+               ptSv->ulLastSeen % SECS_PER_WEEK,
+               ptSv->ulFixCount, ptSv->ulRises,
+               ptSv->sIODE & 0xFF, ptSv->usIodeChanges);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+Function:       OnPacket
+
+Description:    Updates the table from every 0x8F-20 packet received by the
+                parser.
+-----------------------------------------------------------------------------*/
+void CSvTable::OnPacket (CTsipParser *pParser,
+                         unsigned char ucPkt[], int nPktLen)
+{
+    TSIP_8F20 tFix;
+
+    if (nPktLen < 5 || ucPkt[1] != CReport0x8F20::ID ||
+        ucPkt[2] != CReport0x8F20::SUB_ID)
+    {
+        return;
+    }
+
+    if (CReport0x8F20::Decode(&ucPkt[2], nPktLen - 4, &tFix))
+    {
+        Update(tFix);
+    }
+}
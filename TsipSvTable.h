@@ -0,0 +1,87 @@
+/*+ TsipSvTable.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines CSvTable, a per-satellite tracking table kept up to
+ *    date from the 0x8F-20 fix reports of one receiver. Each PRN has a
+ *    fixed slot recording when the SV was first and last used in a fix,
+ *    how many fixes it was used in, how often it came back into use and
+ *    how often its IODE changed. Looking up a PRN is an array index.
+ *
+ * Notes:
+ *    Times are GPS seconds since the start of week 0 (week * 604800 +
+ *    time of week), taken from the fix report itself.
+ *
+-*/
+
+#ifndef TSIP_SV_TABLE_H
+#define TSIP_SV_TABLE_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipParser.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define MAX_SV_PRN        64        // PRN is the low 6 bits of the SV byte
+
+
+/*---------------------------------------------------------------------------*\
+ |                    S T R U C T U R E   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+struct SV_STATE                         // 24 bytes, table fits in 1.5 KB
+{
+    U32 ulFirstSeen;                    // GPS seconds, 0 if never seen
+    U32 ulLastSeen;                     // GPS seconds
+    U32 ulFixCount;                     // fixes this SV was used in
+    U32 ulRises;                        // times it came (back) into use
+    U16 usIodeChanges;                  // IODE changes while in use
+    S16 sIODE;                          // last IODE
+    U8  bInUse;                         // used in the most recent fix
+    U8  ucSpare[3];
+};
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+class CSvTable : public CTsipListener
+{
+
+public: //==== P U B L I C   M E T H O D S ===================================/
+
+    CSvTable();
+
+    void Reset  ();
+    void Update (const TSIP_8F20 &tFix);
+    void Print  (const char *strName) const;
+
+    // O(1) lookup; NULL if the PRN is out of range or was never seen.
+    const SV_STATE *GetSv (U8 ucPrn) const
+    {
+        return (ucPrn < MAX_SV_PRN && m_tSv[ucPrn].ulFirstSeen != 0) ?
+               &m_tSv[ucPrn] : NULL;
+    }
+
+    int GetNumInUse () const { return __builtin_popcountll(m_ullInUse); }
+    U32 GetNumFixes () const { return m_ulFixes; }
+    U32 GetLastFix  () const { return m_ulLastFix; }
+
+    virtual void OnPacket (CTsipParser *pParser,
+                           unsigned char ucPkt[], int nPktLen);
+
+
+private: //==== P R I V A T E   M E M B E R   V A R I A B L E S ==============/
+
+    SV_STATE           m_tSv[MAX_SV_PRN];   // indexed by PRN
+    unsigned long long m_ullInUse;          // bit per PRN in the last fix
+    U32                m_ulFixes;           // fix reports seen
+    U32                m_ulLastFix;         // GPS seconds of the last fix
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*+ TsipTypes.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines the simple data types and the constants shared by
+ *    the TSIP parsers and report decoders.
+ *
+ * Notes:
+ *    S32 and U32 are int-sized so that they stay 32 bits wide on LP64
+ *    hosts, where long is 64 bits.
+ *
+-*/
+
+#ifndef TSIP_TYPES_H
+#define TSIP_TYPES_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                     S I M P L E   D A T A   T Y P E S
+\*---------------------------------------------------------------------------*/
+typedef unsigned char   S8;              /* Signed 8-bit integer (character) */
+typedef unsigned char   U8;              /* Unsigned 8-bit integer (byte)    */
+typedef signed short    S16;             /* Signed 16-bit integer (word)     */
+typedef unsigned short  U16;             /* Unsigned 16-bit integer (word)   */
+typedef signed int      S32;             /* Signed 32-bit integer (long)     */
+typedef unsigned int    U32;             /* Unsigned 32-bit integer (long)   */
+typedef float           FLT;             /* 4-byte single precision (float)  */
+typedef double          DBL;             /* 8-byte double precision (double) */
+
+
+/*---------------------------------------------------------------------------*\
+ |                  C O N S T A N T S   A N D   M A C R O S
+\*---------------------------------------------------------------------------*/
+#define MSG_IN_COMPLETE  0
+#define TSIP_DLE         1
+#define TSIP_IN_PARTIAL  2
+#define TSIP_SKIP        3      // inside a packet that is filtered out
+#define TSIP_SKIP_DLE    4      // same, previous byte was DLE
+
+#define DLE              0x10 // TSIP packet start/end header         
+#define ETX              0x03 // TSIP data packet tail                
+#define MAX_TSIP_PKT_LEN 300  // max length of a TSIP packet 
+
+#define MAX_SC_MESSAGE   13
+#define MAX_EC_MESSAGE   6
+#define MAX_AS1_MESSAGE  4
+
+#define GPS_PI           (3.1415926535898)
+#define R2D              (180.0/GPS_PI)
+#define SECS_PER_WEEK    604800
+
+#define INFO_DGPS        0x02
+#define INFO_2D          0x04
+#define INFO_FILTERED    0x10
+
+#define MAX_LONG         (2147483648.)   /* 2**31 */
+
+#endif
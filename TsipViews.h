@@ -0,0 +1,147 @@
+/*+ TsipViews.h
+ *
+ ******************************************************************************
+ *
+ * Description:
+ *    This file defines views over a framed TSIP packet: lightweight
+ *    objects that check the packet ID, sub-packet ID and length once when
+ *    constructed and then decode a single field each time an accessor is
+ *    called. A consumer that needs one or two fields pays a couple of
+ *    loads per packet instead of a full Decode():
+ *
+ *        CView0x8FAB tTime(ucPkt, nPktLen);
+ *
+ *        if (tTime.IsValid())
+ *            Use(tTime.GetTimeOfWeek());
+ *
+ *    The field offsets and scaling are those of the CReport decoders in
+ *    TsipReports.h.
+ *
+ * Notes:
+ *    A view points into the packet buffer; it must not outlive it. An
+ *    accessor of an invalid view must not be called.
+ *
+-*/
+
+#ifndef TSIP_VIEWS_H
+#define TSIP_VIEWS_H
+
+
+/*---------------------------------------------------------------------------*\
+ |                         I N C L U D E   F I L E S
+\*---------------------------------------------------------------------------*/
+#include "TsipReports.h"
+
+
+/*---------------------------------------------------------------------------*\
+ |                      C L A S S   D E F I N I T I O N S
+\*---------------------------------------------------------------------------*/
+
+// Common part of the views. ucPkt is the unstuffed packet including the
+// leading DLE and trailing DLE ETX, as handed to CTsipListener::OnPacket.
+class CTsipView
+{
+public:
+    bool IsValid () const { return m_pucData != 0; }
+
+protected:
+    CTsipView (const U8 ucPkt[], int nPktLen, U8 ucId, U8 ucSubId,
+               int nLen1, int nLen2)
+    {
+        int nLen = nPktLen - 4;
+
+        m_pucData = 0;
+        if (nPktLen >= 5 && ucPkt[1] == ucId && ucPkt[2] == ucSubId &&
+            (nLen == nLen1 || nLen == nLen2))
+        {
+            m_pucData = &ucPkt[2];
+        }
+    }
+
+    const U8 *m_pucData;                // report data (sub-ID first), or 0
+};
+
+class CView0x8F20 : public CTsipView
+{
+public:
+    CView0x8F20 (const U8 ucPkt[], int nPktLen)
+        : CTsipView(ucPkt, nPktLen, CReport0x8F20::ID, CReport0x8F20::SUB_ID,
+                    56, 64),
+          m_ucMaxSVs(nPktLen - 4 == 64 ? 12 : 8) {};
+
+    DBL GetTimeOfFix () const { return GetULong(&m_pucData[8]) * 0.001; }
+    S16 GetWeekNum   () const { return GetShort(&m_pucData[30]); }
+    U8  GetInfo      () const { return m_pucData[27]; }
+    DBL GetAlt       () const { return GetLong(&m_pucData[20]) * .001; }
+    DBL GetLat       () const
+    {
+        return GetLong(&m_pucData[12]) * (GPS_PI / MAX_LONG);
+    }
+    DBL GetLon       () const
+    {
+        DBL dblLon = GetULong(&m_pucData[16]) * (GPS_PI / MAX_LONG);
+
+        return dblLon > GPS_PI ? dblLon - 2.0 * GPS_PI : dblLon;
+    }
+
+    U8  GetNumSVs () const
+    {
+        return m_pucData[28] > m_ucMaxSVs ? m_ucMaxSVs : m_pucData[28];
+    }
+    U8  GetSvPrn  (int nSv) const { return m_pucData[32 + 2*nSv] & 0x3F; }
+    S16 GetSvIODE (int nSv) const
+    {
+        U8 ucPrn = m_pucData[32 + 2*nSv];
+
+        return (S16)(m_pucData[33 + 2*nSv] + 4 * (ucPrn & 0xC0));
+    }
+
+private:
+    U8 m_ucMaxSVs;
+};
+
+class CView0x8FAB : public CTsipView
+{
+public:
+    CView0x8FAB (const U8 ucPkt[], int nPktLen)
+        : CTsipView(ucPkt, nPktLen, CReport0x8FAB::ID, CReport0x8FAB::SUB_ID,
+                    17, 17) {};
+
+    U32 GetTimeOfWeek () const { return GetULong(&m_pucData[1]); }
+    U16 GetWeekNumber () const { return GetUShort(&m_pucData[5]); }
+    S16 GetUtcOffset  () const { return GetShort(&m_pucData[7]); }
+    U8  GetTimingFlag () const { return m_pucData[9]; }
+    U8  GetSecond     () const { return m_pucData[10]; }
+    U8  GetMinute     () const { return m_pucData[11]; }
+    U8  GetHour       () const { return m_pucData[12]; }
+    U8  GetDay        () const { return m_pucData[13]; }
+    U8  GetMonth      () const { return m_pucData[14]; }
+    U16 GetYear       () const { return GetUShort(&m_pucData[15]); }
+};
+
+class CView0x8FAC : public CTsipView
+{
+public:
+    CView0x8FAC (const U8 ucPkt[], int nPktLen)
+        : CTsipView(ucPkt, nPktLen, CReport0x8FAC::ID, CReport0x8FAC::SUB_ID,
+                    68, 68) {};
+
+    U8  GetReceiverMode         () const { return m_pucData[1]; }
+    U8  GetDiscipliningMode     () const { return m_pucData[2]; }
+    U8  GetSelfSurveyProgress   () const { return m_pucData[3]; }
+    U32 GetHoldoverDuration     () const { return GetULong(&m_pucData[4]); }
+    U16 GetCriticalAlarms       () const { return GetUShort(&m_pucData[8]); }
+    U16 GetMinorAlarms          () const { return GetUShort(&m_pucData[10]); }
+    U8  GetGPSDecodingStatus    () const { return m_pucData[12]; }
+    U8  GetDiscipliningActivity () const { return m_pucData[13]; }
+    FLT GetPPSQuality           () const { return GetSingle(&m_pucData[16]); }
+    FLT GetTenMHzQuality        () const { return GetSingle(&m_pucData[20]); }
+    U32 GetDACValue             () const { return GetULong(&m_pucData[24]); }
+    FLT GetDACVoltage           () const { return GetSingle(&m_pucData[28]); }
+    FLT GetTemperature          () const { return GetSingle(&m_pucData[32]); }
+    DBL GetLatitude             () const { return GetDouble(&m_pucData[36]); }
+    DBL GetLongitude            () const { return GetDouble(&m_pucData[44]); }
+    DBL GetAltitude             () const { return GetDouble(&m_pucData[52]); }
+};
+
+#endif
@@ -1,97 +1,691 @@
 #include     <stdio.h>
-#include     <stdlib.h> 
-#include     <unistd.h>  
+#include     <stdlib.h>
+#include     <unistd.h>
 #include     <sys/types.h>
 #include     <sys/stat.h>
-#include     <fcntl.h> 
+#include     <sys/time.h>
+#include     <sys/resource.h>
+#include     <fcntl.h>
 #include     <termios.h>
 #include     <errno.h>
 #include     <string.h>
+#include     <signal.h>
+#include     <time.h>
 
 #include "TsipParser.h"
+#include "SerialReader.h"
+#include "TsipAwait.h"
+#include "TsipStats.h"
+#include "TsipSvTable.h"
+#include "TsipHistory.h"
+#include "TsipMux.h"
+#include "RtReader.h"
+#include "SerialPort.h"
+#include "TsipCheckpoint.h"
+#include "TsipViews.h"
+#include "NtpShm.h"
 
-#define PKT_LEN 300
-   
-int main()
+#define WATCHDOG_MS 5000  // warn when a port sends no 0x8F-AB for this long
+
+static volatile sig_atomic_t g_bStop = 0;
+
+static void OnSignal(int nSig)
+{
+    g_bStop = 1;
+}
+
+// Runs for the life of the program, one per port, and reports when the
+// receiver stops (and starts again) sending its once-a-second timing packet.
+static CTsipTask WatchPort(CTsipWaitHub *pHub, CTsipParser *pParser, int nPort)
 {
+    TSIP_8FAB tTime;
+    bool bSilent = false;
+
+    while(!g_bStop)
+    {
+        if(co_await pHub->NextReport<CReport0x8FAB>(pParser, WATCHDOG_MS, &tTime))
+        {
+            if(bSilent)
+            {
+                fprintf(stderr, "port %d: timing packets resumed\n", nPort);
+            }
+            bSilent = false;
+        }
+        else if(!bSilent)
+        {
+            fprintf(stderr, "port %d: no timing packet for %d s\n",
+                    nPort, WATCHDOG_MS / 1000);
+            bSilent = true;
+        }
+    }
+}
+
+// Opens a port and configures it. With bDetect the port is left as it
+// is; DetectPorts() finds the settings the receiver is using.
+static int OpenPort(const char *strDev, PORT_SETTINGS tSettings, bool bDetect)
+{
+    char strSettings[32];
     int fd;
-    int i;
-    int len;
-    int n = 0;      
-    unsigned char read_buf[PKT_LEN];
-    unsigned char data_buf[PKT_LEN];
-    struct termios opt; 
-    
-    fd = open("/dev/ttyS0", O_RDWR);    
-    if(fd == -1)
-    {
-        perror("open serial 0\n");
-        exit(0);
-    }
-
-    tcgetattr(fd, &opt);      
-    cfsetispeed(&opt, B9600);
-    cfsetospeed(&opt, B9600);
-    
-    if(tcsetattr(fd, TCSANOW, &opt) != 0 )
-    {     
-       perror("tcsetattr error");
-       return -1;
-    }
-    opt.c_cflag &= ~(PARENB | PARODD | CRTSCTS);
-	opt.c_cflag |= CREAD | CLOCAL;
-	opt.c_iflag = opt.c_oflag = opt.c_lflag = (tcflag_t) 0;
-
-opt.c_iflag &=~ (PARMRK | INPCK);
-	opt.c_cflag &=~ (CSIZE | CSTOPB | PARENB | PARODD);
-
-
-    opt.c_cflag |= CS8;   
-    opt.c_iflag |= INPCK;
-	    opt.c_cflag |= PARENB | PARODD;
- 
-    
-   
-
-    opt.c_cc[VTIME] = 0;
-    opt.c_cc[VMIN] = 0;
-    
-    tcflush(fd, TCIOFLUSH);
- 
-    printf("configure complete\n");
-    
-    if(tcsetattr(fd, TCSANOW, &opt) != 0)
+
+    fd = PortOpen(strDev);
+    if(fd == -1 || bDetect)
+    {
+        return fd;
+    }
+
+    if(!PortConfigure(fd, tSettings))
     {
         perror("serial error");
+        close(fd);
+        return -1;
+    }
+
+    PortFormat(tSettings, strSettings, sizeof(strSettings));
+    printf("configure complete: %s %s\n", strDev, strSettings);
+    return fd;
+}
+
+// Finds the settings of all ports at once.
+static void DetectPorts(int nDevs, const int fds[], const char **pstrDevs,
+                        PORT_SETTINGS tSettings)
+{
+    PORT_SETTINGS tFound[MAX_READER_PORTS];
+    bool bFound[MAX_READER_PORTS];
+    char strSettings[32];
+    int i;
+
+    printf("detecting port settings ...\n");
+    for(i = 0; i < nDevs; i++)
+    {
+        tFound[i] = tSettings;
+    }
+    PortDetectAll(nDevs, fds, DETECT_LISTEN_MS, tFound, bFound);
+
+    for(i = 0; i < nDevs; i++)
+    {
+        PortFormat(tFound[i], strSettings, sizeof(strSettings));
+        if(!bFound[i])
+        {
+            fprintf(stderr, "%s: no TSIP reports found, using %s\n",
+                    pstrDevs[i], strSettings);
+        }
+        printf("configure complete: %s %s\n", pstrDevs[i], strSettings);
+    }
+}
+
+// Reader statistics for the nDevs real ports; the pty traffic of a mux
+// is counted on its own line.
+static void PrintStats(CSerialReader *pReader, int nDevs, CTsipMux *pMuxes[],
+                       struct rusage *ptStart)
+{
+    struct rusage tNow;
+    const READER_STATS &tStats = pReader->GetStats();
+    double dblCpu;
+    U32 ulPkts = 0, ulFiltered = 0, ulFilteredBytes = 0;
+    U32 ulPtyBytes = 0, ulPtyDrops = 0, ulPtyCmds = 0, ulCmdErrors = 0;
+    int nPtys = 0;
+    int i, j;
+
+    for(i = 0; i < nDevs; i++)
+    {
+        ulPkts += pReader->GetPort(i).pParser->GetPktCount();
+        ulFiltered += pReader->GetPort(i).pParser->GetFilteredPkts();
+        ulFilteredBytes += pReader->GetPort(i).pParser->GetFilteredBytes();
+    }
+
+    getrusage(RUSAGE_SELF, &tNow);
+    dblCpu = (tNow.ru_utime.tv_sec  - ptStart->ru_utime.tv_sec) +
+             (tNow.ru_stime.tv_sec  - ptStart->ru_stime.tv_sec) +
+             (tNow.ru_utime.tv_usec - ptStart->ru_utime.tv_usec) * 1e-6 +
+             (tNow.ru_stime.tv_usec - ptStart->ru_stime.tv_usec) * 1e-6;
+
+    printf("stats: %s  ports: %d  pkts: %u  reads: %u  syscalls: %u"
+           "  syscalls/pkt: %.3f  cpu/port: %.3f s\n",
+           pReader->GetBackend() == READER_IO_URING ? "io_uring" : "epoll",
+           nDevs, ulPkts, tStats.ulReads, tStats.ulSyscalls,
+           ulPkts ? (double)tStats.ulSyscalls / ulPkts : 0.0,
+           nDevs ? dblCpu / nDevs : 0.0);
+    if(ulFiltered > 0)
+    {
+        printf("stats: filtered pkts: %u  bytes: %u (%.1f%% of input)\n",
+               ulFiltered, ulFilteredBytes,
+               tStats.ulBytes ? 100.0 * ulFilteredBytes / tStats.ulBytes : 0.0);
+    }
+
+    for(i = 0; i < nDevs; i++)
+    {
+        if(pMuxes[i] == NULL)
+        {
+            continue;
+        }
+        for(j = 0; j < pMuxes[i]->GetNumPtys(); j++)
+        {
+            ulPtyBytes += pMuxes[i]->GetPty(j).ulBytes;
+            ulPtyDrops += pMuxes[i]->GetPty(j).ulDrops;
+            ulPtyCmds  += pMuxes[i]->GetPty(j).ulCmds;
+            nPtys++;
+        }
+        ulCmdErrors += pMuxes[i]->GetCmdErrors();
+    }
+    if(nPtys > 0)
+    {
+        printf("stats: mux  ptys: %d  bytes out: %u  drops: %u  cmds: %u"
+               "  cmd errors: %u\n",
+               nPtys, ulPtyBytes, ulPtyDrops, ulPtyCmds, ulCmdErrors);
+    }
+}
+
+// Parses a filter list such as "8f:ab,8f:ac,47" into ucIds/nSubIds.
+static int ParseFilter(char *strList, U8 ucIds[], int nSubIds[], int nMax)
+{
+    char *strItem, *strEnd;
+    int n = 0;
+
+    for(strItem = strtok(strList, ","); strItem != NULL && n < nMax;
+        strItem = strtok(NULL, ","))
+    {
+        ucIds[n] = (U8)strtoul(strItem, &strEnd, 16);
+        nSubIds[n] = NO_SUB_ID;
+        if(*strEnd == ':')
+        {
+            nSubIds[n] = (int)strtoul(strEnd + 1, &strEnd, 16);
+        }
+        if(*strEnd != '\0')
+        {
+            return -1;
+        }
+        n++;
+    }
+    return n;
+}
+
+// Adds ucId/nSubId to a -f list unless the list already lets it through,
+// so that a consumer that was asked for is not starved by the filter.
+static void AcceptNeeded(U8 ucIds[], int nSubIds[], int *pnFilters,
+                         U8 ucId, int nSubId, const char *strWhy)
+{
+    int i;
+
+    for(i = 0; i < *pnFilters; i++)
+    {
+        if(ucIds[i] == ucId &&
+           (nSubIds[i] == NO_SUB_ID || nSubIds[i] == nSubId))
+        {
+            return;
+        }
+    }
+
+    ucIds[*pnFilters] = ucId;
+    nSubIds[*pnFilters] = nSubId;
+    (*pnFilters)++;
+    printf("-f: also accepting %02x:%02x for %s\n", ucId, nSubId, strWhy);
+}
+
+static void PrintSvTables(int nDevs, CSvTable *pSvs[], const char **pstrDevs)
+{
+    int i;
+
+    for(i = 0; i < nDevs; i++)
+    {
+        if(pSvs[i] != NULL)
+        {
+            pSvs[i]->Print(pstrDevs[i]);
+        }
+    }
+}
+
+// Names a port's checkpoint file after the device rather than its place
+// on the command line, so a restart with the ports listed in another
+// order still restores each receiver's own state.
+static void CheckpointFile(char *strFile, int nSize, const char *strCkpt,
+                           const char *strDev)
+{
+    const char *strName = strrchr(strDev, '/');
+
+    snprintf(strFile, nSize, "%s.%s", strCkpt,
+             strName != NULL ? strName + 1 : strDev);
+}
+
+// Tells what a restarted reader already knows about its port.
+static void PrintRestored(const char *strDev, CTsipCheckpoint *pCkpt)
+{
+    const CKPT_REPORT *ptRep;
+    struct timespec tNow;
+    double dblAge;
+
+    if(!pCkpt->IsRestored())
+    {
+        printf("%s: new checkpoint\n", strDev);
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &tNow);
+    printf("%s: checkpoint restored, restart %u, %u packets so far\n",
+           strDev, pCkpt->GetRestarts(), pCkpt->GetPktCount());
+
+    if((ptRep = pCkpt->GetReport(CKPT_8FAB)) != NULL)
+    {
+        CView0x8FAB tTime(ptRep->ucPkt, ptRep->usPktLen);
+
+        dblAge = tNow.tv_sec + tNow.tv_nsec * 1e-9 - ptRep->llArrivalNs * 1e-9;
+        printf("%s: last time %04u:%06u GPS, %.1f s ago%s\n", strDev,
+               tTime.GetWeekNumber(), tTime.GetTimeOfWeek(), dblAge,
+               pCkpt->IsStale(CKPT_8FAB) ? " (stale)" : "");
+    }
+    if((ptRep = pCkpt->GetReport(CKPT_8FAC)) != NULL)
+    {
+        CView0x8FAC tStat(ptRep->ucPkt, ptRep->usPktLen);
+
+        printf("%s: last alarms critical %04X minor %04X%s\n", strDev,
+               tStat.GetCriticalAlarms(), tStat.GetMinorAlarms(),
+               pCkpt->IsStale(CKPT_8FAC) ? " (stale)" : "");
+    }
+    if(pCkpt->GetHistory() != NULL)
+    {
+        printf("%s: %u packets in restored history\n", strDev,
+               pCkpt->GetHistory()->GetNextSeq());
+    }
+}
+
+static void Usage(const char *strProg)
+{
+    fprintf(stderr, "usage: %s [-a] [-b baud[:parity[:stop]]] [-u] [-q] [-r] [-t]\n"
+                    "       [-H recs] [-m ptys] [-f ids] [-R prio[:cpu]] [-l]\n"
+                    "       [-w file] [-n unit] [-s secs] [device ...]\n"
+                    "  -a       detect each port's baud rate and parity\n"
+                    "  -b baud  port settings, e.g. 115200:n:1 (default 9600:o:1)\n"
+                    "  -u       read with io_uring instead of epoll\n"
+                    "  -q       do not print the decoded packets\n"
+                    "  -r       print 0x8F-AC timing quality rollups\n"
+                    "  -t       track satellites from 0x8F-20 fix reports\n"
+                    "  -H recs  keep the last recs packets of each port in memory\n"
+                    "  -m ptys  re-export each port on ptys pseudo-terminals\n"
+                    "  -f ids   only frame these packets, e.g. 8f:ab,8f:ac,47, and\n"
+                    "           those the other options need\n"
+                    "  -R prio  run the reader SCHED_FIFO at prio, pinned to cpu,\n"
+                    "           with its memory locked\n"
+                    "  -l       measure wake-up jitter and decode latency\n"
+                    "  -w file  checkpoint each port's state to file.<device name>,\n"
+                    "           e.g. file.ttyS0\n"
+                    "  -n unit  feed 0x8F-AB time to NTP SHM unit, unit+1, ...\n"
+                    "  -s secs  print reader statistics every secs seconds\n",
+                    strProg);
+}
+
+int main(int argc, char *argv[])
+{
+    int fd;
+    int i, j;
+    int nOpt;
+    int nTimeoutMs;
+    int nChunks;
+    int nBackend = READER_EPOLL;
+    int nStatSecs = 0;
+    int nHistRecs = 0;
+    int nMuxPtys = 0;
+    int nPty;
+    int nPort;
+    int fds[MAX_READER_PORTS];
+    int nFilters = 0;
+    U8 ucFilterIds[256];
+    int nRtPrio = 0;
+    int nRtCpu = -1;
+    char *strCpu;
+    CLatencyStats *pLatency = NULL;
+    PORT_SETTINGS tSettings = gtTsipDefault;
+    bool bDetect = false;
+    const char *strCkpt = NULL;
+    char strFile[256];
+    CTsipCheckpoint *pCkpts[MAX_READER_PORTS];
+    time_t tLastSync;
+    int nShmUnit = -1;
+    CNtpShm *pShms[MAX_READER_PORTS];
+    int nFilterSubIds[256];
+    bool bPrint = true;
+    bool bRollups = false;
+    bool bSvTable = false;
+    time_t tLastStats;
+    struct rusage tStart;
+    const char *strDefault = "/dev/ttyS0";
+    const char **pstrDevs;
+    int nDevs;
+    CSerialReader reader;
+    CTsipWaitHub hub;
+    CTimingStats *pStats[MAX_READER_PORTS];
+    CSvTable *pSvs[MAX_READER_PORTS];
+    CTsipHistory *pHist[MAX_READER_PORTS];
+    CTsipMux *pMux;
+    CTsipMux *pMuxes[MAX_READER_PORTS];
+
+    while((nOpt = getopt(argc, argv, "ab:uqrtH:m:f:R:lw:n:s:")) != -1)
+    {
+        switch(nOpt)
+        {
+            case 'a': bDetect = true;                break;
+            case 'b':
+                if(!PortParse(optarg, &tSettings))
+                {
+                    Usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'u': nBackend = READER_IO_URING;    break;
+            case 'q': bPrint = false;                break;
+            case 'r': bRollups = true;               break;
+            case 't': bSvTable = true;               break;
+            case 'H': nHistRecs = atoi(optarg);      break;
+            case 'm': nMuxPtys = atoi(optarg);       break;
+            case 'f':
+                // Leave room for the IDs added by AcceptNeeded().
+                nFilters = ParseFilter(optarg, ucFilterIds, nFilterSubIds, 250);
+                if(nFilters <= 0)
+                {
+                    Usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'R':
+                nRtPrio = atoi(optarg);
+                if((strCpu = strchr(optarg, ':')) != NULL)
+                {
+                    nRtCpu = atoi(strCpu + 1);
+                }
+                break;
+            case 'w': strCkpt = optarg;              break;
+            case 'n': nShmUnit = atoi(optarg);       break;
+            case 'l': pLatency = new CLatencyStats(); break;
+            case 's': nStatSecs = atoi(optarg);      break;
+            default:  Usage(argv[0]);                return -1;
+        }
+    }
+
+    // The watchdog always needs 0x8F-AB; the other consumers only when
+    // they are enabled.
+    if(nFilters > 0)
+    {
+        AcceptNeeded(ucFilterIds, nFilterSubIds, &nFilters, 0x8F, 0xAB,
+                     "the watchdog");
+        if(bRollups)
+        {
+            AcceptNeeded(ucFilterIds, nFilterSubIds, &nFilters, 0x8F, 0xAC,
+                         "-r");
+        }
+        if(bSvTable)
+        {
+            AcceptNeeded(ucFilterIds, nFilterSubIds, &nFilters, 0x8F, 0x20,
+                         "-t");
+        }
+        if(nShmUnit >= 0)
+        {
+            AcceptNeeded(ucFilterIds, nFilterSubIds, &nFilters, 0x8F, 0xAC,
+                         "-n");
+        }
+        if(strCkpt != NULL)
+        {
+            AcceptNeeded(ucFilterIds, nFilterSubIds, &nFilters, 0x8F, 0xAC,
+                         "-w");
+            AcceptNeeded(ucFilterIds, nFilterSubIds, &nFilters, 0x8F, 0x20,
+                         "-w");
+        }
+        if(nHistRecs > 0)
+        {
+            printf("-f: the history only keeps the packets -f accepts\n");
+        }
+    }
+
+    if(!reader.Open(nBackend))
+    {
+        if(nBackend != READER_IO_URING || !reader.Open(READER_EPOLL))
+        {
+            return -1;
+        }
+        printf("io_uring not available, using epoll\n");
+    }
+
+    nDevs = argc - optind;
+    pstrDevs = (const char **)&argv[optind];
+    if(nDevs == 0)
+    {
+        nDevs = 1;
+        pstrDevs = &strDefault;
+    }
+
+    if(nDevs > MAX_READER_PORTS)
+    {
+        fprintf(stderr, "too many ports\n");
         return -1;
     }
+
+    // All ports are opened first so that -a can probe them at once.
+    for(i = 0; i < nDevs; i++)
+    {
+        fds[i] = OpenPort(pstrDevs[i], tSettings, bDetect);
+        if(fds[i] == -1)
+        {
+            exit(0);
+        }
+    }
+    if(bDetect)
+    {
+        DetectPorts(nDevs, fds, pstrDevs, tSettings);
+    }
+
+    for(i = 0; i < nDevs; i++)
+    {
+        fd = fds[i];
+
+        CTsipParser *ctp = new CTsipParser();
+        ctp->SetPrint(bPrint);
+        if(nFilters > 0)
+        {
+            ctp->RejectAll();
+            for(j = 0; j < nFilters; j++)
+            {
+                ctp->Accept(ucFilterIds[j], nFilterSubIds[j]);
+            }
+        }
+        nPort = reader.AddPort(fd, ctp);
+        if(nPort == -1)
+        {
+            fprintf(stderr, "too many ports\n");
+            return -1;
+        }
+        if(!hub.Attach(ctp) ||
+           (pLatency != NULL && !ctp->AddListener(pLatency)))
+        {
+            fprintf(stderr, "%s: too many listeners\n", pstrDevs[i]);
+            return -1;
+        }
+        WatchPort(&hub, ctp, i);
+
+        pStats[i] = NULL;
+        if(bRollups)
+        {
+            pStats[i] = new CTimingStats(pstrDevs[i]);
+            if(!ctp->AddListener(pStats[i]))
+            {
+                fprintf(stderr, "%s: too many listeners\n", pstrDevs[i]);
+                return -1;
+            }
+        }
+
+        pSvs[i] = NULL;
+        if(bSvTable)
+        {
+            pSvs[i] = new CSvTable();
+            if(!ctp->AddListener(pSvs[i]))
+            {
+                fprintf(stderr, "%s: too many listeners\n", pstrDevs[i]);
+                return -1;
+            }
+        }
+
+        pShms[i] = NULL;
+        if(nShmUnit >= 0)
+        {
+            pShms[i] = new CNtpShm();
+            if(!pShms[i]->Open(nShmUnit + i))
+            {
+                return -1;
+            }
+            if(!ctp->AddListener(pShms[i]))
+            {
+                fprintf(stderr, "%s: too many listeners\n", pstrDevs[i]);
+                return -1;
+            }
+            printf("%s: NTP SHM unit %d\n", pstrDevs[i], nShmUnit + i);
+        }
+
+        // With a checkpoint the history lives in the checkpoint file.
+        pCkpts[i] = NULL;
+        if(strCkpt != NULL)
+        {
+            CheckpointFile(strFile, sizeof(strFile), strCkpt, pstrDevs[i]);
+            pCkpts[i] = new CTsipCheckpoint();
+            if(!pCkpts[i]->Open(strFile, nHistRecs))
+            {
+                return -1;
+            }
+            if(!ctp->AddListener(pCkpts[i]))
+            {
+                fprintf(stderr, "%s: too many listeners\n", pstrDevs[i]);
+                return -1;
+            }
+            PrintRestored(pstrDevs[i], pCkpts[i]);
+        }
+
+        pHist[i] = NULL;
+        if(pCkpts[i] != NULL && pCkpts[i]->GetHistory() != NULL)
+        {
+            pHist[i] = pCkpts[i]->GetHistory();
+        }
+        else if(nHistRecs > 0)
+        {
+            pHist[i] = new CTsipHistory(nHistRecs);
+        }
+        if(pHist[i] != NULL && !ctp->AddListener(pHist[i]))
+        {
+            fprintf(stderr, "%s: too many listeners\n", pstrDevs[i]);
+            return -1;
+        }
+
+        // Now that all the listeners are in place they get the reports
+        // restored from the checkpoint, e.g. the SV table its last fix.
+        if(pCkpts[i] != NULL)
+        {
+            pCkpts[i]->Replay(ctp);
+        }
+
+        // The ptys are read like ports, after all the real ports so that
+        // port i is still pstrDevs[i].
+        pMuxes[i] = NULL;
+        if(nMuxPtys > 0)
+        {
+            pMux = new CTsipMux(&reader, nPort);
+            for(nPty = 0; nPty < nMuxPtys && nPty < MAX_MUX_PTYS; nPty++)
+            {
+                if(pMux->AddPty() == -1)
+                {
+                    return -1;
+                }
+                printf("%s: re-exported on %s\n", pstrDevs[i],
+                       pMux->GetPty(nPty).strName);
+            }
+            pMuxes[i] = pMux;
+        }
+    }
+
+    for(i = 0; i < nDevs && nMuxPtys > 0; i++)
+    {
+        for(nPty = 0; nPty < pMuxes[i]->GetNumPtys(); nPty++)
+        {
+            if(reader.AddPort(pMuxes[i]->GetPty(nPty).fdMaster,
+                              pMuxes[i]->GetPty(nPty).pParser, true) == -1)
+            {
+                fprintf(stderr, "too many ports\n");
+                return -1;
+            }
+        }
+    }
+
+    // Last, so that everything allocated so far is locked and pre-faulted.
+    if(nRtPrio > 0)
+    {
+        if(!EnterRealTime(nRtPrio, nRtCpu))
+        {
+            fprintf(stderr, "real-time mode not fully enabled\n");
+        }
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    getrusage(RUSAGE_SELF, &tStart);
+    tLastStats = time(NULL);
+    tLastSync = tLastStats;
+
     printf("start send and receive data\n");
-  
-    while(1)
-    {    
-        n = 0;
-        len = 0;
-        memset(&read_buf, 0,sizeof(read_buf));   
-        memset(&data_buf, 0,sizeof(data_buf));
- 
-        while( (n = read(fd, read_buf, sizeof(read_buf))) > 0 )
-        {
-            for(i = len; i < (len + n); i++)
+
+    while(!g_bStop && reader.GetNumActive() > 0)
+    {
+        nTimeoutMs = hub.NextTimeoutMs(1000);
+        if(pLatency != NULL)
+        {
+            nTimeoutMs = pLatency->BeginWait(nTimeoutMs);
+        }
+        nChunks = reader.Poll(nTimeoutMs);
+        if(nChunks < 0)
+        {
+            break;
+        }
+        if(pLatency != NULL)
+        {
+            pLatency->EndWait(nChunks, reader.GetWakeTime());
+        }
+        hub.ExpireTimeouts();
+
+        for(i = 0; i < nDevs; i++)
+        {
+            if(pStats[i] != NULL)
             {
-                data_buf[i] = read_buf[i - len];
+                pStats[i]->Tick(time(NULL));
             }
-            len += n;
-        }
-        data_buf[len] = '\0';
-              
-	/*for(i = 0; i < len; i++) {
-		printf("%x ", data_buf[i]);
-	}
-        printf("\n");*/
- 
-        CTsipParser *ctp = new CTsipParser();
-        ctp->ReceivePkt(data_buf, len);
-        sleep(1);
+        }
+
+        if(strCkpt != NULL && time(NULL) - tLastSync >= CKPT_SYNC_SECS)
+        {
+            for(i = 0; i < nDevs; i++)
+            {
+                pCkpts[i]->Sync();
+            }
+            tLastSync = time(NULL);
+        }
+
+        if(nStatSecs > 0 && time(NULL) - tLastStats >= nStatSecs)
+        {
+            PrintStats(&reader, nDevs, pMuxes, &tStart);
+            PrintSvTables(nDevs, pSvs, pstrDevs);
+            if(pLatency != NULL)
+            {
+                pLatency->Print("reader");
+                pLatency->Reset();
+            }
+            tLastStats = time(NULL);
+        }
+    }
+
+    PrintStats(&reader, nDevs, pMuxes, &tStart);
+    PrintSvTables(nDevs, pSvs, pstrDevs);
+    if(pLatency != NULL)
+    {
+        pLatency->Print("reader");
+    }
+    for(i = 0; i < nDevs && strCkpt != NULL; i++)
+    {
+        delete pCkpts[i];
+    }
+    for(i = 0; i < nDevs && nShmUnit >= 0; i++)
+    {
+        delete pShms[i];
     }
     return 0;
 }